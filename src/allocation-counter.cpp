@@ -0,0 +1,45 @@
+#include "allocation-counter.hpp"
+
+#include <stdlib.h>
+
+#include <new>
+
+static thread_local size_t nbAllocations = 0;
+
+size_t threadAllocationCount()
+{
+    return nbAllocations;
+}
+
+void * operator new(size_t size)
+{
+    nbAllocations++;
+    if (void * pointer = malloc(size == 0 ? 1 : size))
+        return pointer;
+    throw std::bad_alloc();
+}
+
+void * operator new[](size_t size)
+{
+    return operator new(size);
+}
+
+void operator delete(void * pointer) noexcept
+{
+    free(pointer);
+}
+
+void operator delete[](void * pointer) noexcept
+{
+    free(pointer);
+}
+
+void operator delete(void * pointer, size_t) noexcept
+{
+    free(pointer);
+}
+
+void operator delete[](void * pointer, size_t) noexcept
+{
+    free(pointer);
+}
@@ -0,0 +1,10 @@
+#pragma once
+
+#include <stddef.h>
+
+/**
+ * @brief Number of heap allocations made by the calling thread so far
+ * @details Only available in builds configured with -Dcount_allocations=true,
+ *          which replace the global operator new (see allocation-counter.cpp).
+ */
+size_t threadAllocationCount();
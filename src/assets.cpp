@@ -0,0 +1,137 @@
+#include "assets.hpp"
+
+#include <stdio.h>
+
+#include <stdexcept>
+
+#ifdef HEXABOMB_VISU_EMBED_ASSETS
+    #include "embedded-assets.hpp"
+#endif
+#include "util.hpp"
+
+/// Returns the embedded asset of this basename, or nullptr if assets are not embedded.
+static const void * embeddedAsset(const std::string & filename, size_t & size)
+{
+#ifdef HEXABOMB_VISU_EMBED_ASSETS
+    const EmbeddedAsset * asset = findEmbeddedAsset(filename);
+    if (asset != nullptr)
+    {
+        size = asset->size;
+        return asset->data;
+    }
+#endif
+    (void) filename;
+    size = 0;
+    return nullptr;
+}
+
+Assets::Assets(bool searchFiles)
+{
+    loadImageAsync(BOMB, "bomb.png", searchFiles);
+    loadImageAsync(CHARACTER, "char.png", searchFiles);
+    loadImageAsync(DEAD_CHARACTER, "char_dead.png", searchFiles);
+    loadImageAsync(SPECIAL_CHARACTER, "char_special.png", searchFiles);
+    loadImageAsync(EXPLOSION, "explosion.png", searchFiles);
+
+    const std::string fontFilename = "DejaVuSansMono.ttf";
+    size_t fontSize = 0;
+    const void * fontData = searchFiles ? nullptr : embeddedAsset(fontFilename, fontSize);
+    if (fontData != nullptr)
+        monospaceFont.loadFromMemory(fontData, fontSize);
+    else
+        monospaceFont.loadFromFile(searchFontAbsoluteFilename(fontFilename));
+
+    // Rasterize the printable ASCII glyphs of the players information panel sizes,
+    // so that the first turns do not pay for it.
+    for (const unsigned int characterSize : {14u, 20u})
+    {
+        for (sf::Uint32 c = ' '; c <= '~'; c++)
+            monospaceFont.getGlyph(c, characterSize, false);
+    }
+}
+
+void Assets::loadImageAsync(ImageID id, const std::string & filename, bool searchFiles)
+{
+    PendingImage pending;
+    pending.id = id;
+
+    size_t size = 0;
+    const void * data = searchFiles ? nullptr : embeddedAsset(filename, size);
+    if (data != nullptr)
+    {
+        pending.image = std::async(std::launch::async, [filename, data, size]()
+        {
+            sf::Image image;
+            if (!image.loadFromMemory(data, size))
+                throw std::runtime_error("Could not decode embedded image '" + filename + "'");
+            return image;
+        });
+    }
+    else
+    {
+        // Image files are searched now, so that missing files are reported right away.
+        const std::string absoluteFilename = searchImageAbsoluteFilename(filename);
+        pending.image = std::async(std::launch::async, [absoluteFilename]()
+        {
+            sf::Image image;
+            if (!image.loadFromFile(absoluteFilename))
+                throw std::runtime_error("Could not load image '" + absoluteFilename + "'");
+            return image;
+        });
+    }
+
+    _pendingImages.push_back(std::move(pending));
+}
+
+bool Assets::poll()
+{
+    for (auto it = _pendingImages.begin(); it != _pendingImages.end(); )
+    {
+        if (it->image.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+        {
+            ++it;
+            continue;
+        }
+
+        // An image that cannot be decoded is reported, and stays empty: Its sprites are not drawn.
+        try
+        {
+            _images[it->id] = it->image.get();
+        }
+        catch (const std::exception & e)
+        {
+            printf("%s\n", e.what());
+            fflush(stdout);
+        }
+        it = _pendingImages.erase(it);
+    }
+
+    return isReady();
+}
+
+bool Assets::isReady() const
+{
+    return _pendingImages.empty();
+}
+
+void Assets::freezeFont(const std::vector<unsigned int> & characterSizes)
+{
+    for (const unsigned int characterSize : characterSizes)
+    {
+        for (sf::Uint32 c = ' '; c <= '~'; c++)
+            monospaceFont.getGlyph(c, characterSize, false);
+    }
+
+    // Textures are only read back once all glyphs are in, as adding glyphs may resize them.
+    for (const unsigned int characterSize : characterSizes)
+    {
+        const sf::Texture & texture = monospaceFont.getTexture(characterSize);
+        _fontImages[&texture] = texture.copyToImage();
+    }
+}
+
+const sf::Image * Assets::fontImage(const sf::Texture * texture) const
+{
+    auto it = _fontImages.find(texture);
+    return it != _fontImages.end() ? &it->second : nullptr;
+}
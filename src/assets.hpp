@@ -0,0 +1,77 @@
+#pragma once
+
+#include <future>
+#include <unordered_map>
+#include <vector>
+
+#include <SFML/Graphics.hpp>
+
+/**
+ * @brief The images and font used to render hexabomb games.
+ * @details Loaded once per process and shared (read-only) by every HexabombRenderer.
+ *          Images are the full-size masters. Renderers rasterize them at their display size into a SpriteAtlas.
+ *          Assets are read from the executable if they have been embedded at build time,
+ *          and searched on the filesystem otherwise.
+ *          The font is loaded right away so that text can be displayed immediately.
+ *          Images are decoded in parallel on worker threads, and collected by poll().
+ */
+class Assets
+{
+public:
+    enum ImageID
+    {
+        BOMB,
+        CHARACTER,
+        DEAD_CHARACTER,
+        SPECIAL_CHARACTER,
+        EXPLOSION,
+        NB_IMAGES
+    };
+
+    /**
+     * @brief Start loading the assets
+     * @param searchFiles Whether assets are searched on the filesystem even if they are embedded in the executable
+     */
+    explicit Assets(bool searchFiles = false);
+
+    /**
+     * @brief Collect the images decoded so far
+     * @details Images that cannot be loaded are reported on the standard output, and stay empty.
+     * @return Whether all images are ready
+     */
+    bool poll();
+
+    /// Whether all images are ready.
+    bool isReady() const;
+
+    /// The full-size image of id. Empty until it is ready.
+    const sf::Image & image(ImageID id) const { return _images[id]; }
+
+    /**
+     * @brief Rasterize the printable ASCII glyphs of these character sizes, and copy the font textures to main memory
+     * @details sf::Font only writes to its glyph cache for glyphs it has not rasterized yet. Afterwards, renderers
+     *          on several threads can thus share the font, as long as they only lay out printable ASCII.
+     *          Must be called before these threads start.
+     */
+    void freezeFont(const std::vector<unsigned int> & characterSizes);
+
+    /// The font texture (of a frozen character size) in main memory, or nullptr.
+    const sf::Image * fontImage(const sf::Texture * texture) const;
+
+    sf::Font monospaceFont;
+
+private:
+    void loadImageAsync(ImageID id, const std::string & filename, bool searchFiles);
+
+private:
+    /// An image being decoded.
+    struct PendingImage
+    {
+        ImageID id;
+        std::future<sf::Image> image;
+    };
+
+    sf::Image _images[NB_IMAGES];
+    std::vector<PendingImage> _pendingImages;
+    std::unordered_map<const sf::Texture *, sf::Image> _fontImages; //!< See freezeFont.
+};
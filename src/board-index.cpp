@@ -0,0 +1,53 @@
+#include "board-index.hpp"
+
+#include <algorithm>
+#include <limits>
+
+void BoardIndex::build(const std::unordered_map<Coordinates, Cell> & cells)
+{
+    _coordinates.clear();
+    _coordinates.reserve(cells.size());
+    for (const auto & [coord, cell] : cells)
+        _coordinates.push_back(coord);
+    std::sort(_coordinates.begin(), _coordinates.end());
+
+    int qMax = std::numeric_limits<int>::min();
+    int rMax = std::numeric_limits<int>::min();
+    _qMin = std::numeric_limits<int>::max();
+    _rMin = std::numeric_limits<int>::max();
+    for (const auto & coord : _coordinates)
+    {
+        _qMin = std::min(_qMin, coord.q);
+        _rMin = std::min(_rMin, coord.r);
+        qMax = std::max(qMax, coord.q);
+        rMax = std::max(rMax, coord.r);
+    }
+
+    if (_coordinates.empty())
+    {
+        _qMin = _rMin = 0;
+        _qSpan = _rSpan = 0;
+        _grid.clear();
+        _neighbors.clear();
+        return;
+    }
+
+    _qSpan = qMax - _qMin + 1;
+    _rSpan = rMax - _rMin + 1;
+    _grid.assign(_qSpan * _rSpan, -1);
+    for (int i = 0; i < size(); i++)
+    {
+        const Coordinates & coord = _coordinates[i];
+        _grid[(coord.q - _qMin) * _rSpan + (coord.r - _rMin)] = i;
+    }
+
+    // Axial directions, counterclockwise from +q.
+    static const Coordinates directions[NB_DIRECTIONS] = {{1, 0}, {1, -1}, {0, -1}, {-1, 0}, {-1, 1}, {0, 1}};
+    _neighbors.resize(size() * NB_DIRECTIONS);
+    for (int i = 0; i < size(); i++)
+    {
+        const Coordinates & coord = _coordinates[i];
+        for (int d = 0; d < NB_DIRECTIONS; d++)
+            _neighbors[i * NB_DIRECTIONS + d] = indexOf(Coordinates{coord.q + directions[d].q, coord.r + directions[d].r});
+    }
+}
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <unordered_map>
+#include <vector>
+
+#include "hexabomb-parse.hpp"
+
+/**
+ * @brief Dense numbering of the cells of a board
+ * @details Cells are numbered from 0 to size()-1 in lexicographical order of their coordinates.
+ *          Coordinates are mapped to indices through a grid over the bounding box of the board,
+ *          so that per-turn lookups need no hashing.
+ *          The 6 neighbors of each cell are tabulated as well, so that walking along a direction
+ *          (e.g. the rays of a bomb) costs one table read per cell.
+ */
+class BoardIndex
+{
+public:
+    /// Number the cells of a board. Previous numbering is discarded.
+    void build(const std::unordered_map<Coordinates, Cell> & cells);
+
+    /// The number of cells.
+    int size() const { return _coordinates.size(); }
+
+    /// Returns the index of the cell at coord, or -1 if there is no such cell.
+    int indexOf(const Coordinates & coord) const
+    {
+        const int q = coord.q - _qMin;
+        const int r = coord.r - _rMin;
+        if (q < 0 || r < 0 || q >= _qSpan || r >= _rSpan)
+            return -1;
+        return _grid[q * _rSpan + r];
+    }
+
+    /// Returns the coordinates of the index-th cell.
+    const Coordinates & coordinates(int index) const { return _coordinates[index]; }
+
+    static const int NB_DIRECTIONS = 6;
+
+    /// Returns the index of the neighbor of a cell in a direction (in [0, NB_DIRECTIONS)), or -1 if there is no such cell.
+    int neighbor(int index, int direction) const { return _neighbors[index * NB_DIRECTIONS + direction]; }
+
+    /// The heap memory held, in bytes.
+    size_t memoryUsage() const
+    {
+        return (_grid.capacity() + _neighbors.capacity()) * sizeof(int) + _coordinates.capacity() * sizeof(Coordinates);
+    }
+
+private:
+    int _qMin = 0;
+    int _rMin = 0;
+    int _qSpan = 0;
+    int _rSpan = 0;
+    std::vector<int> _grid; //!< Cell index of each (q,r) of the bounding box, -1 for holes.
+    std::vector<Coordinates> _coordinates;
+    std::vector<int> _neighbors; //!< NB_DIRECTIONS neighbor indices per cell, -1 for holes.
+};
@@ -0,0 +1,74 @@
+#include "board-kernels.hpp"
+
+#include <stddef.h>
+#include <string.h>
+
+#include <algorithm>
+
+static_assert(sizeof(sf::Color) == sizeof(uint32_t), "sf::Color must be 4 packed bytes");
+
+uint32_t packColor(sf::Color color)
+{
+    uint32_t packed;
+    memcpy(&packed, &color, sizeof(packed));
+    return packed;
+}
+
+void recolorCells(const int * drawColors, const int * colors, int nbCells,
+    const uint32_t * palette, sf::Vertex * vertices, int verticesPerHex,
+    int * histogram, int nbColors, std::vector<int> & scratch)
+{
+    const int nbPartials = 4;
+    scratch.assign(nbPartials * nbColors, 0);
+    int * partial0 = scratch.data();
+    int * partial1 = partial0 + nbColors;
+    int * partial2 = partial1 + nbColors;
+    int * partial3 = partial2 + nbColors;
+
+    // Cells are processed in blocks small enough for their packed colors to stay in L1.
+    const int blockSize = 256;
+    uint32_t packed[blockSize];
+    const size_t colorOffset = offsetof(sf::Vertex, color);
+    unsigned char * vertexBytes = reinterpret_cast<unsigned char *>(vertices);
+
+    for (int begin = 0; begin < nbCells; begin += blockSize)
+    {
+        const int nbBlockCells = std::min(blockSize, nbCells - begin);
+        const int * blockColors = colors + begin;
+
+        // Counting reads the colors as a contiguous array. Increments go to data-dependent addresses,
+        // which SIMD cannot scatter without conflict detection: The loop is unrolled instead,
+        // so that the four increments of an iteration are independent.
+        int i = 0;
+        for (; i + nbPartials <= nbBlockCells; i += nbPartials)
+        {
+            partial0[blockColors[i]]++;
+            partial1[blockColors[i + 1]]++;
+            partial2[blockColors[i + 2]]++;
+            partial3[blockColors[i + 3]]++;
+        }
+        for (; i < nbBlockCells; i++)
+            partial0[blockColors[i]]++;
+
+        if (vertices == nullptr)
+            continue;
+
+        // Palette expansion: Contiguous index loads and color stores, vectorized (as gathers with AVX2, see meson.build).
+        const int * blockDrawColors = drawColors + begin;
+        for (i = 0; i < nbBlockCells; i++)
+            packed[i] = palette[blockDrawColors[i]];
+
+        // sf::Vertex interleaves colors with positions and texture coordinates (20-byte stride):
+        // Each vertex gets its 32-bit color word, without touching the rest of the vertex.
+        unsigned char * hex = vertexBytes + (size_t) begin * verticesPerHex * sizeof(sf::Vertex) + colorOffset;
+        for (i = 0; i < nbBlockCells; i++, hex += verticesPerHex * sizeof(sf::Vertex))
+        {
+            for (int v = 0; v < verticesPerHex; v++)
+                memcpy(hex + v * sizeof(sf::Vertex), &packed[i], sizeof(uint32_t));
+        }
+    }
+
+    // A sum of contiguous arrays, which compilers vectorize.
+    for (int color = 0; color < nbColors; color++)
+        histogram[color] = partial0[color] + partial1[color] + partial2[color] + partial3[color];
+}
@@ -0,0 +1,32 @@
+#pragma once
+
+#include <stdint.h>
+
+#include <vector>
+
+#include <SFML/Graphics.hpp>
+
+/**
+ * @brief Color the cell vertices from their palette index and count the cells of each color
+ * @param drawColors The palette index each cell is drawn with (nbCells entries), in [0, nbColors)
+ * @param colors The actual color of each cell (nbCells entries), in [0, nbColors). Not checked.
+ * @param nbCells The number of cells
+ * @param palette The palette (packed RGBA, see packColor)
+ * @param vertices The cell vertices (verticesPerHex per cell), or nullptr to only count colors
+ * @param verticesPerHex The number of vertices of each cell
+ * @param histogram Set to the number of cells of each color (nbColors entries)
+ * @param nbColors The number of colors
+ * @param scratch Reused between calls to avoid allocations
+ * @details Cells are read once, in blocks: Each block is counted, its palette indices are expanded
+ *          into a contiguous array of packed colors, then copied to the vertices.
+ *          The histogram is accumulated into 4 interleaved partial histograms, so that consecutive
+ *          cells of the same color do not serialize on the same counter, and merged at the end.
+ *          Vertex colors are written as 32-bit words, with no sf::Color construction nor bounds check
+ *          per vertex. The kernel is compiled with the vectorization flags set in meson.build.
+ */
+void recolorCells(const int * drawColors, const int * colors, int nbCells,
+    const uint32_t * palette, sf::Vertex * vertices, int verticesPerHex,
+    int * histogram, int nbColors, std::vector<int> & scratch);
+
+/// Pack a color as the 32-bit word sf::Color is laid out as in memory.
+uint32_t packColor(sf::Color color);
@@ -0,0 +1,20 @@
+#pragma once
+
+#include <stddef.h>
+
+#include <string>
+
+/// An asset file compiled into the executable (see the embed_assets build option).
+struct EmbeddedAsset
+{
+    const char * filename; //!< The asset basename (e.g., "bomb.png").
+    const unsigned char * data;
+    size_t size;
+};
+
+/**
+ * @brief Search an asset compiled into the executable
+ * @param filename The asset basename (e.g., "bomb.png")
+ * @return The asset if it has been embedded, nullptr otherwise.
+ */
+const EmbeddedAsset * findEmbeddedAsset(const std::string & filename);
@@ -0,0 +1,30 @@
+#include "frame-readback.hpp"
+
+void FrameReadback::capture(const sf::RenderWindow & window)
+{
+    // The oldest frame is lost if it has not been collected.
+    sf::Texture & texture = _textures[_next];
+    if (texture.getSize() != window.getSize())
+    {
+        // The frames of the previous size are not worth keeping.
+        if (!texture.create(window.getSize().x, window.getSize().y))
+            return;
+        _nbCaptured = 0;
+    }
+
+    texture.update(window);
+    _next = (_next + 1) % _depth;
+    if (_nbCaptured < _depth)
+        _nbCaptured++;
+}
+
+const sf::Image * FrameReadback::collect(bool flush)
+{
+    if (_nbCaptured == 0 || (_nbCaptured < _depth && !flush))
+        return nullptr;
+
+    const int oldest = (_next - _nbCaptured + _depth) % _depth;
+    _nbCaptured--;
+    _image = _textures[oldest].copyToImage();
+    return &_image;
+}
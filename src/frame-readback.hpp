@@ -0,0 +1,34 @@
+#pragma once
+
+#include <SFML/Graphics.hpp>
+
+/**
+ * @brief Reads the frames of a window back to main memory without waiting for the GPU
+ * @details Reading the window right after drawing would stall until the GPU is done with the frame.
+ *          Instead, each frame is copied into a texture by the GPU itself, and read back a few frames
+ *          later, when that copy is long done. SFML gives no access to pixel buffer objects, so the
+ *          read back is still a synchronous transfer, but it no longer waits for the frame to be drawn.
+ */
+class FrameReadback
+{
+public:
+    /// Copy the window content, on the GPU. Call after drawing and before display().
+    void capture(const sf::RenderWindow & window);
+
+    /**
+     * @brief Read the oldest captured frame back
+     * @param flush Read it even if it is recent, e.g. when no frame will follow for a while
+     * @return The frame, valid until the next call, or nullptr if no frame is old enough
+     */
+    const sf::Image * collect(bool flush);
+
+    /// Forget the captured frames, e.g. when nobody needs them anymore.
+    void clear() { _nbCaptured = 0; }
+
+private:
+    static const int _depth = 2; //!< Frames are read back this many frames after they were captured.
+    sf::Texture _textures[_depth];
+    int _next = 0; //!< The texture of the next capture.
+    int _nbCaptured = 0; //!< Captured frames not read back yet.
+    sf::Image _image;
+};
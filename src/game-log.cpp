@@ -0,0 +1,60 @@
+#include "game-log.hpp"
+
+#include <fstream>
+
+GameLogWriter::~GameLogWriter()
+{
+    if (_file != nullptr)
+        fclose(_file);
+}
+
+bool GameLogWriter::open(const std::string & filename)
+{
+    if (_file != nullptr)
+        fclose(_file);
+
+    _file = fopen(filename.c_str(), "a");
+    return _file != nullptr;
+}
+
+void GameLogWriter::write(const std::string & message, const netorcai::json & parsedMessage)
+{
+    if (_file == nullptr)
+        return;
+
+    // netorcai sends compact JSON. Anything else is written again on a single line.
+    if (message.find('\n') == std::string::npos)
+        fwrite(message.data(), 1, message.size(), _file);
+    else
+    {
+        const std::string line = parsedMessage.dump();
+        fwrite(line.data(), 1, line.size(), _file);
+    }
+    fputc('\n', _file);
+}
+
+void GameLogWriter::flush()
+{
+    if (_file != nullptr)
+        fflush(_file);
+}
+
+bool readGameLog(const std::string & filename, const std::function<void(netorcai::json & message)> & function)
+{
+    std::ifstream file(filename);
+    if (!file)
+        return false;
+
+    std::string line;
+    netorcai::json message;
+    while (std::getline(file, line))
+    {
+        if (line.empty())
+            continue;
+
+        message = netorcai::json::parse(line);
+        function(message);
+    }
+
+    return !file.bad();
+}
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <stdio.h>
+
+#include <functional>
+#include <string>
+
+#include <netorcai-client-cpp/message.hpp>
+
+/**
+ * @brief Records the netorcai messages of games into a log file
+ * @details A log holds one netorcai message per line (JSON lines), as received from netorcai:
+ *          GAME_STARTS, then TURN messages, then GAME_ENDS. Several games may follow one another
+ *          in the same log (sessions). Logs are appended to, so that they survive reconnections.
+ */
+class GameLogWriter
+{
+public:
+    GameLogWriter() = default;
+    ~GameLogWriter();
+
+    GameLogWriter(const GameLogWriter &) = delete;
+    GameLogWriter & operator=(const GameLogWriter &) = delete;
+
+    /// Open the log file for appending. Returns whether it could be opened.
+    bool open(const std::string & filename);
+    bool isOpen() const { return _file != nullptr; }
+
+    /**
+     * @brief Append a message
+     * @param message The message, as received from netorcai
+     * @param parsedMessage The same message parsed, only used if message spans several lines
+     */
+    void write(const std::string & message, const netorcai::json & parsedMessage);
+
+    /// Write the buffered messages to the file, e.g. when a game ends.
+    void flush();
+
+private:
+    FILE * _file = nullptr;
+};
+
+/**
+ * @brief Read the messages of a log file in order
+ * @param filename The log, as written by GameLogWriter
+ * @param function Called on each message. The message is reused between calls.
+ * @return Whether the file could be read. Throws netorcai::json::exception on a malformed line.
+ */
+bool readGameLog(const std::string & filename, const std::function<void(netorcai::json & message)> & function);
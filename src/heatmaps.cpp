@@ -0,0 +1,44 @@
+#include "heatmaps.hpp"
+
+void Heatmaps::reset(int nbCells, int nbColors)
+{
+    _nbCells = nbCells;
+    _nbColors = nbColors;
+
+    _ownerChanges.assign(nbCells, 0);
+    _explosions.assign(nbCells, 0);
+    _presence.assign(nbCells, 0);
+    _presenceByColor.assign(nbCells * nbColors, 0);
+    _dominantColor.assign(nbCells, 0);
+
+    for (auto & maxCount : _maxCount)
+        maxCount = 0;
+}
+
+uint32_t Heatmaps::count(Kind kind, int cell) const
+{
+    switch (kind)
+    {
+        case OWNER_CHANGES: return _ownerChanges[cell];
+        case EXPLOSIONS: return _explosions[cell];
+        case PRESENCE: return _presence[cell];
+        default: return 0;
+    }
+}
+
+size_t Heatmaps::memoryUsage() const
+{
+    return (_ownerChanges.capacity() + _explosions.capacity() + _presence.capacity() + _presenceByColor.capacity()) * sizeof(uint32_t)
+        + _dominantColor.capacity() * sizeof(int);
+}
+
+const char * Heatmaps::kindName(Kind kind)
+{
+    switch (kind)
+    {
+        case OWNER_CHANGES: return "owner changes";
+        case EXPLOSIONS: return "explosions";
+        case PRESENCE: return "presence";
+        default: return "unknown";
+    }
+}
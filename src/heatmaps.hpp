@@ -0,0 +1,71 @@
+#pragma once
+
+#include <stdint.h>
+
+#include <algorithm>
+#include <vector>
+
+/**
+ * @brief Per-cell counters accumulated over the turns of a game
+ * @details Counters are dense arrays indexed by BoardIndex cell indices.
+ *          They are updated incrementally while the renderer applies each turn.
+ */
+class Heatmaps
+{
+public:
+    enum Kind
+    {
+        OWNER_CHANGES, //!< How many times each cell changed color.
+        EXPLOSIONS,    //!< How many times each cell was in an explosion.
+        PRESENCE,      //!< How many turns alive characters spent on each cell, per color.
+        NB_KINDS
+    };
+
+    /// Reset all counters to zero for a board of nbCells cells and nbColors cell colors.
+    void reset(int nbCells, int nbColors);
+
+    void addOwnerChange(int cell)
+    {
+        _maxCount[OWNER_CHANGES] = std::max(_maxCount[OWNER_CHANGES], ++_ownerChanges[cell]);
+    }
+
+    void addExplosion(int cell)
+    {
+        _maxCount[EXPLOSIONS] = std::max(_maxCount[EXPLOSIONS], ++_explosions[cell]);
+    }
+
+    void addPresence(int cell, int color)
+    {
+        if (color < 0 || color >= _nbColors)
+            return;
+
+        const uint32_t colorPresence = ++_presenceByColor[color * _nbCells + cell];
+        _maxCount[PRESENCE] = std::max(_maxCount[PRESENCE], ++_presence[cell]);
+        if (colorPresence > _presenceByColor[_dominantColor[cell] * _nbCells + cell])
+            _dominantColor[cell] = color;
+    }
+
+    /// The counter of a cell. For PRESENCE, all colors are summed.
+    uint32_t count(Kind kind, int cell) const;
+
+    /// The maximum counter over all cells.
+    uint32_t maxCount(Kind kind) const { return _maxCount[kind]; }
+
+    /// The color whose characters spent the most time on a cell.
+    int dominantColor(int cell) const { return _dominantColor[cell]; }
+
+    /// The heap memory held, in bytes.
+    size_t memoryUsage() const;
+
+    static const char * kindName(Kind kind);
+
+private:
+    int _nbCells = 0;
+    int _nbColors = 0;
+    std::vector<uint32_t> _ownerChanges;
+    std::vector<uint32_t> _explosions;
+    std::vector<uint32_t> _presence;
+    std::vector<uint32_t> _presenceByColor; //!< Indexed by color * nbCells + cell.
+    std::vector<int> _dominantColor;
+    uint32_t _maxCount[NB_KINDS] = {0, 0, 0};
+};
@@ -0,0 +1,170 @@
+#include <stdio.h>
+
+#include <algorithm>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <boost/filesystem.hpp>
+#include <boost/program_options.hpp>
+
+#include "game-log.hpp"
+#include "match-summary.hpp"
+#include "thread-pool.hpp"
+#include "util.hpp"
+
+namespace fs = boost::filesystem;
+
+/// The summaries of the games of one log, or why it could not be read.
+struct LogResult
+{
+    std::vector<MatchSummary> summaries;
+    std::string error;
+};
+
+/**
+ * @brief Expand directories into the logs they contain, recursively
+ * @details Logs are sorted by name, so that results do not depend on the filesystem order.
+ */
+static std::vector<std::string> listLogs(const std::vector<std::string> & paths)
+{
+    std::vector<std::string> logs;
+    for (const auto & path : paths)
+    {
+        if (!fs::is_directory(path))
+        {
+            logs.push_back(path);
+            continue;
+        }
+
+        for (fs::recursive_directory_iterator it(path), end; it != end; ++it)
+        {
+            if (fs::is_regular_file(it->status()))
+                logs.push_back(it->path().string());
+        }
+    }
+
+    std::sort(logs.begin(), logs.end());
+    return logs;
+}
+
+/// Summarize the games of a log. Games read before a malformed line are kept.
+static void analyzeLog(const std::string & filename, LogResult & result)
+{
+    MatchAnalyzer analyzer;
+    try
+    {
+        if (!readGameLog(filename, [&analyzer](netorcai::json & message) { analyzer.onMessage(message); }))
+            result.error = "cannot read file";
+    }
+    catch (const std::exception & e)
+    {
+        result.error = e.what();
+    }
+
+    analyzer.finishLog();
+    result.summaries = analyzer.summaries();
+}
+
+int main(int argc, char * argv[])
+{
+    std::vector<std::string> paths;
+    std::string outputFilename = "matches.csv";
+    int nbThreads = std::max(0, (int)std::thread::hardware_concurrency() - 1);
+
+    namespace po = boost::program_options;
+    po::options_description desc("Options description");
+    desc.add_options()
+            ("help", "print usage message")
+            ("output,o", po::value(&outputFilename),
+             "write one row per player of each game to this CSV file (default: matches.csv)")
+            ("threads", po::value(&nbThreads),
+             "number of worker threads besides the main one (default: one less than the number of cores)")
+            ("logs", po::value(&paths)->multitoken(),
+             "game logs recorded with hexabomb-visu --record, or directories that contain them")
+            ;
+    po::positional_options_description positional;
+    positional.add("logs", -1);
+
+    try
+    {
+        po::variables_map vm;
+        po::store(po::command_line_parser(argc, argv).options(desc).positional(positional).run(), vm); // throws on error
+
+        if (vm.count("help") > 0)
+        {
+            printf("Usage : %s [options] LOG_OR_DIRECTORY...\n\n", argv[0]);
+            std::cout << desc << "\n";
+            return 0;
+        }
+
+        po::notify(vm);
+
+        if (nbThreads < 0)
+            throw po::error("--threads must be positive or zero");
+        if (paths.empty())
+            throw po::error("no game log given");
+    }
+    catch(boost::program_options::error& e)
+    {
+        std::cerr << "ERROR: " << e.what() << "\n";
+        return 1;
+    }
+
+    std::vector<std::string> logs;
+    try
+    {
+        logs = listLogs(paths);
+    }
+    catch (const fs::filesystem_error & e)
+    {
+        std::cerr << "ERROR: " << e.what() << "\n";
+        return 1;
+    }
+
+    // One task per log. Logs are independent, and each task only writes its own result.
+    const int64_t startMicroseconds = monotonicMicroseconds();
+    std::vector<LogResult> results(logs.size());
+    std::vector<std::function<void()> > tasks;
+    for (unsigned int i = 0; i < logs.size(); i++)
+        tasks.push_back([&logs, &results, i]() { analyzeLog(logs[i], results[i]); });
+
+    ThreadPool threadPool(nbThreads);
+    threadPool.run(tasks);
+    threadPool.wait();
+
+    // Rows are gathered in log order, whatever the order logs were analyzed in.
+    MatchTable table;
+    int nbGames = 0;
+    long long nbTurns = 0;
+    int nbErrors = 0;
+    for (unsigned int i = 0; i < logs.size(); i++)
+    {
+        if (!results[i].error.empty())
+        {
+            printf("%s: %s\n", logs[i].c_str(), results[i].error.c_str());
+            nbErrors++;
+        }
+
+        for (const auto & summary : results[i].summaries)
+        {
+            table.append(logs[i], summary);
+            nbTurns += summary.nbTurns;
+        }
+        nbGames += results[i].summaries.size();
+    }
+    const double seconds = (monotonicMicroseconds() - startMicroseconds) / 1e6;
+
+    printf("%zu logs, %d games, %lld turns analyzed in %.2f s (%.0f turns/s) with %d threads\n",
+        logs.size(), nbGames, nbTurns, seconds, seconds > 0 ? nbTurns / seconds : 0.0, nbThreads + 1);
+
+    if (!table.exportCSV(outputFilename))
+    {
+        printf("Cannot write results to %s\n", outputFilename.c_str());
+        return 1;
+    }
+    printf("Results written to %s\n", outputFilename.c_str());
+
+    return nbErrors > 0 ? 2 : 0;
+}
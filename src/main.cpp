@@ -1,19 +1,77 @@
 #include <stdio.h>
 
+#include <algorithm>
 #include <iostream>
+#include <memory>
 #include <string>
 #include <thread>
+#include <vector>
 
 #include <boost/program_options.hpp>
 #include <boost/program_options/parsers.hpp>
 
+#include "metrics.hpp"
+#include "relay.hpp"
+#include "render-benchmark.hpp"
+#include "render-farm.hpp"
 #include "threads.hpp"
+#include "trace.hpp"
+#include "util.hpp"
+
+/// A netorcai instance to connect to.
+struct Endpoint
+{
+    std::string hostname;
+    uint16_t port;
+};
+
+/**
+ * @brief Parse a hostname:port endpoint
+ * @param str The string to parse (e.g., "localhost:4242")
+ * @return The parsed endpoint. Throws boost::program_options::error on invalid input.
+ */
+static Endpoint parseEndpoint(const std::string & str)
+{
+    const size_t colon = str.rfind(':');
+    if (colon == std::string::npos || colon == 0 || colon + 1 == str.size())
+        throw boost::program_options::error("invalid endpoint '" + str + "' (expected hostname:port)");
+
+    Endpoint endpoint;
+    endpoint.hostname = str.substr(0, colon);
+    try
+    {
+        const int port = std::stoi(str.substr(colon + 1));
+        if (port <= 0 || port > 65535)
+            throw std::out_of_range("port");
+        endpoint.port = port;
+    }
+    catch (const std::exception &)
+    {
+        throw boost::program_options::error("invalid port in endpoint '" + str + "'");
+    }
+
+    return endpoint;
+}
 
 int main(int argc, char * argv[])
 {
     // Parse main arguments.
     std::string hostname = "localhost";
     uint16_t port = 4242;
+    std::vector<std::string> dashboardEndpoints;
+    std::vector<Endpoint> endpoints;
+    uint16_t relayPort = 0;
+    uint16_t metricsPort = 0;
+    std::string recordFilename;
+    bool isViewer = false;
+    int benchmarkRadius = 0;
+    int benchmarkFrames = 100;
+    std::vector<std::string> farmLogs;
+    const int nbCores = std::max(1, (int)std::thread::hardware_concurrency());
+    int nbRenderWorkers = std::max(1, nbCores / 2);
+    int nbEncodeWorkers = std::max(1, nbCores / 2);
+    RendererOptions rendererOptions;
+    rendererOptions.nbThreads = std::min(7, std::max(0, (int)std::thread::hardware_concurrency() - 1));
 
     namespace po = boost::program_options;
     po::options_description desc("Options description");
@@ -23,6 +81,52 @@ int main(int argc, char * argv[])
              "netorcai instance's hostname")
             ("port,p", po::value(&port),
              "netorcai instance's TCP port")
+            ("dashboard,d", po::value(&dashboardEndpoints)->multitoken(),
+             "watch several games in one window (list of hostname:port)")
+            ("relay-port", po::value(&relayPort),
+             "re-broadcast the game to viewers on this local TCP port")
+            ("metrics-port", po::value(&metricsPort),
+             "serve Prometheus metrics on http://localhost:PORT/metrics")
+            ("viewer", po::bool_switch(&isViewer),
+             "receive the game from a relaying hexabomb-visu instead of netorcai")
+            ("record", po::value(&recordFilename),
+             "append the received netorcai messages to this game log, for hexabomb-stats (one log per dashboard tile)")
+            ("stats-csv", po::value(&rendererOptions.statsFilename),
+             "write per-turn player statistics to this CSV file when the game ends")
+            ("session", po::bool_switch(&rendererOptions.session),
+             "keep the window open after GAME_ENDS and show the next games as they start")
+            ("threads", po::value(&rendererOptions.nbThreads),
+             "number of worker threads used to update large boards (default: one less than the number of cores, up to 7)")
+            ("search-assets", po::bool_switch(&rendererOptions.searchAssets),
+             "search images and fonts on the filesystem even if they are embedded in the executable")
+            ("max-fps", po::value(&rendererOptions.maxFramerate),
+             "frames per second while the games change (default: 60)")
+            ("playout-delay", po::value(&rendererOptions.playoutDelayMilliseconds),
+             "hold turns up to this many milliseconds, so that they are shown at a steady pace when players answer unevenly (default: 0, turns are shown as they arrive)")
+            ("idle-delay", po::value(&rendererOptions.idleDelayMilliseconds),
+             "milliseconds without change after which the window stops redrawing and sleeps until the next message (default: 500)")
+#ifdef HEXABOMB_VISU_MJPEG
+            ("mjpeg-port", po::value(&rendererOptions.mjpegPort),
+             "stream the frames as MJPEG on http://localhost:PORT/, e.g. for remote spectators (disabled by default)")
+            ("mjpeg-quality", po::value(&rendererOptions.mjpegQuality),
+             "JPEG quality of the streamed frames, from 1 to 100 (default: 80)")
+#endif
+            ("software-render", po::bool_switch(&rendererOptions.softwareRendering),
+             "draw games on the CPU instead of OpenGL (for machines without GPU)")
+            ("export-frames", po::value(&rendererOptions.framesDirectory),
+             "save the window as a PNG image into this directory each time a message is received")
+            ("trace", po::value(&rendererOptions.traceFilename),
+             "record a timeline of the network and renderer threads, written to this Chrome trace file when T is pressed and at exit")
+            ("benchmark-render", po::value(&benchmarkRadius),
+             "compare the OpenGL and software renderers on a board of this radius, then exit")
+            ("benchmark-frames", po::value(&benchmarkFrames),
+             "number of frames drawn by each renderer in --benchmark-render (default: 100)")
+            ("render-logs", po::value(&farmLogs)->multitoken(),
+             "render the games of these logs (see --record) into --export-frames, several at a time, then exit")
+            ("render-workers", po::value(&nbRenderWorkers),
+             "number of games drawn at the same time by --render-logs (default: half the number of cores)")
+            ("encode-workers", po::value(&nbEncodeWorkers),
+             "number of threads that write the PNG frames of --render-logs (default: half the number of cores)")
             ;
 
     try
@@ -38,6 +142,38 @@ int main(int argc, char * argv[])
         }
 
         po::notify(vm);
+
+        for (const auto & str : dashboardEndpoints)
+            endpoints.push_back(parseEndpoint(str));
+        if (endpoints.empty())
+            endpoints.push_back(Endpoint{hostname, port});
+
+        if (rendererOptions.nbThreads < 0)
+            throw po::error("--threads must be positive or zero");
+
+        if (rendererOptions.playoutDelayMilliseconds < 0)
+            throw po::error("--playout-delay must be positive or zero");
+
+        if (rendererOptions.mjpegQuality < 1 || rendererOptions.mjpegQuality > 100)
+            throw po::error("--mjpeg-quality must be between 1 and 100");
+
+        if (rendererOptions.maxFramerate <= 0 || rendererOptions.idleDelayMilliseconds < 0)
+            throw po::error("--max-fps must be strictly positive and --idle-delay positive or zero");
+
+        if (benchmarkRadius < 0 || benchmarkFrames <= 0)
+            throw po::error("--benchmark-render must be positive and --benchmark-frames strictly positive");
+
+        if (!recordFilename.empty() && isViewer)
+            throw po::error("--record requires netorcai connections (not --viewer)");
+
+        if (!farmLogs.empty() && rendererOptions.framesDirectory.empty())
+            throw po::error("--render-logs requires --export-frames");
+
+        if (nbRenderWorkers <= 0 || nbEncodeWorkers <= 0)
+            throw po::error("--render-workers and --encode-workers must be strictly positive");
+
+        if (relayPort != 0 && (endpoints.size() > 1 || isViewer))
+            throw po::error("--relay-port requires a single netorcai connection");
     }
     catch(boost::program_options::required_option& e)
     {
@@ -51,15 +187,77 @@ int main(int argc, char * argv[])
     }
 
     // End of argument parsing.
-    boost::lockfree::queue<Message> to_network(2);
-    boost::lockfree::queue<Message> to_renderer(2);
+    trace::setEnabled(!rendererOptions.traceFilename.empty());
+
+    if (benchmarkRadius > 0)
+        return render_benchmark(benchmarkRadius, benchmarkFrames, rendererOptions);
+
+    if (!farmLogs.empty())
+        return render_farm(farmLogs, nbRenderWorkers, nbEncodeWorkers, rendererOptions);
+
+    // One network thread per netorcai connection, each with its own queues.
+    std::vector<std::unique_ptr<boost::lockfree::queue<Message> > > to_network, to_renderer;
+    std::vector<boost::lockfree::queue<Message> *> to_network_ptrs, to_renderer_ptrs;
+    std::vector<std::thread> network_threads;
 
-    auto network_thread = std::thread(network_thread_function,
-        &to_network, &to_renderer, hostname, port);
-    renderer_thread_function(&to_renderer, &to_network);
+    // The relay serves viewers from its own thread, so they cannot slow the network thread down.
+    boost::lockfree::queue<Message> to_relay(16);
+    std::thread relay_thread;
+    if (relayPort != 0)
+        relay_thread = std::thread(relay_thread_function, &to_relay, relayPort);
+
+    // Metrics are served from their own thread, so that scrapes never slow rendering down.
+    metrics().setNbGames(endpoints.size());
+    boost::lockfree::queue<Message> to_metrics(1);
+    std::thread metrics_thread;
+    if (metricsPort != 0)
+        metrics_thread = std::thread(metrics_thread_function, &to_metrics, metricsPort);
+
+    for (unsigned int i = 0; i < endpoints.size(); i++)
+    {
+        const Endpoint & endpoint = endpoints[i];
+        to_network.emplace_back(new boost::lockfree::queue<Message>(2));
+        to_renderer.emplace_back(new boost::lockfree::queue<Message>(2));
+        to_network_ptrs.push_back(to_network.back().get());
+        to_renderer_ptrs.push_back(to_renderer.back().get());
+
+        if (isViewer)
+            network_threads.push_back(std::thread(viewer_network_thread_function,
+                to_network.back().get(), to_renderer.back().get(), endpoint.hostname, endpoint.port,
+                rendererOptions.session, &metrics().game(i)));
+        else
+            network_threads.push_back(std::thread(network_thread_function,
+                to_network.back().get(), to_renderer.back().get(), endpoint.hostname, endpoint.port,
+                relayPort != 0 ? &to_relay : nullptr,
+                recordFilename.empty() ? "" : numberedFilename(recordFilename, i, endpoints.size(), 0),
+                rendererOptions.session, &metrics().game(i)));
+    }
+    renderer_thread_function(to_renderer_ptrs, to_network_ptrs, rendererOptions);
 
-    network_thread.join();
-    flush_queues(&to_network, &to_renderer);
+    for (unsigned int i = 0; i < network_threads.size(); i++)
+    {
+        network_threads[i].join();
+        flush_queues(to_network[i].get(), to_renderer[i].get());
+    }
+
+    if (relay_thread.joinable())
+        relay_thread.join();
+
+    if (metrics_thread.joinable())
+    {
+        Message msg;
+        msg.type = MessageType::TERMINATE;
+        to_metrics.push(msg);
+        metrics_thread.join();
+    }
+
+    if (trace::isEnabled())
+    {
+        if (trace::exportJSON(rendererOptions.traceFilename))
+            printf("Trace written to %s\n", rendererOptions.traceFilename.c_str());
+        else
+            printf("Cannot write trace to %s\n", rendererOptions.traceFilename.c_str());
+    }
 
     return 0;
 }
@@ -0,0 +1,199 @@
+#include "match-summary.hpp"
+
+#include <stdio.h>
+
+#include <numeric>
+
+using namespace netorcai;
+
+void MatchAnalyzer::onMessage(const json & message)
+{
+    const std::string & messageType = message["message_type"].get_ref<const std::string &>();
+    if (messageType == "GAME_STARTS")
+    {
+        finishLog();
+        onGameStarts(message);
+    }
+    else if (messageType == "TURN" && _inGame)
+        onGameState(message["game_state"], message["turn_number"].get<int>() + 1);
+    else if (messageType == "GAME_ENDS" && _inGame)
+    {
+        onGameState(message["game_state"], _summaries.back().nbTurns);
+        _summaries.back().isComplete = true;
+        finishGame();
+    }
+}
+
+void MatchAnalyzer::finishLog()
+{
+    if (_inGame)
+        finishGame();
+}
+
+void MatchAnalyzer::onGameStarts(const json & message)
+{
+    _summaries.emplace_back();
+    MatchSummary & summary = _summaries.back();
+    summary.gameIndex = _summaries.size() - 1;
+
+    for (const auto & player : parsePlayersInfo(message["players_info"]))
+    {
+        summary.playerIDs.push_back(player.playerID);
+        summary.nicknames.push_back(player.nickname);
+    }
+    const int nbPlayers = summary.playerIDs.size();
+    for (auto * column : {&summary.ranks, &summary.finalScores, &summary.finalCellCounts,
+        &summary.bombsPlaced, &summary.explosionAreas, &summary.deaths})
+        column->assign(nbPlayers, 0);
+
+    _cells.clear();
+    _score.clear();
+    _cellCount.clear();
+    _wasAlive.clear();
+    _leader = -1;
+    _stats.reset(summary.playerIDs);
+    _inGame = true;
+
+    onGameState(message["initial_game_state"], 0);
+}
+
+void MatchAnalyzer::onGameState(const json & gameState, int nbTurns)
+{
+    parseGameState(gameState, _cells, _characters, _bombs, _explosions, _score, _cellCount);
+    _stats.append(nbTurns, _characters, _bombs, _explosions, _score, _cellCount);
+
+    MatchSummary & summary = _summaries.back();
+    summary.nbTurns = nbTurns;
+
+    for (const auto & character : _characters)
+    {
+        auto it = _wasAlive.find(character.id);
+        if (it != _wasAlive.end() && it->second && !character.isAlive)
+        {
+            const int index = playerIndexFromColor(character.color);
+            if (index >= 0)
+                summary.deaths[index]++;
+        }
+        _wasAlive[character.id] = character.isAlive;
+    }
+
+    // The leader has the strictly best score.
+    int leader = -1;
+    int bestScore = 0;
+    for (unsigned int i = 0; i < summary.playerIDs.size(); i++)
+    {
+        auto it = _score.find(summary.playerIDs[i]);
+        const int score = it != _score.end() ? it->second : 0;
+        if (leader == -1 || score > bestScore)
+        {
+            leader = i;
+            bestScore = score;
+        }
+        else if (score == bestScore)
+            leader = -2;
+    }
+
+    if (leader >= 0 && leader != _leader)
+    {
+        if (_leader >= 0)
+            summary.leadChanges++;
+        _leader = leader;
+    }
+}
+
+void MatchAnalyzer::finishGame()
+{
+    MatchSummary & summary = _summaries.back();
+    const int nbPlayers = summary.playerIDs.size();
+
+    for (int i = 0; i < nbPlayers; i++)
+    {
+        auto it = _score.find(summary.playerIDs[i]);
+        summary.finalScores[i] = it != _score.end() ? it->second : 0;
+        it = _cellCount.find(summary.playerIDs[i]);
+        summary.finalCellCounts[i] = it != _cellCount.end() ? it->second : 0;
+
+        // Counters are summed when the store downsamples, so their total is exact.
+        const auto & bombsPlaced = _stats.column(StatsStore::BOMBS_PLACED, i);
+        summary.bombsPlaced[i] = std::accumulate(bombsPlaced.begin(), bombsPlaced.end(), 0);
+        const auto & explosionArea = _stats.column(StatsStore::EXPLOSION_AREA, i);
+        summary.explosionAreas[i] = std::accumulate(explosionArea.begin(), explosionArea.end(), 0);
+    }
+
+    for (int i = 0; i < nbPlayers; i++)
+    {
+        summary.ranks[i] = 1;
+        for (int j = 0; j < nbPlayers; j++)
+            if (summary.finalScores[j] > summary.finalScores[i])
+                summary.ranks[i]++;
+    }
+
+    _inGame = false;
+}
+
+int MatchAnalyzer::playerIndexFromColor(int color) const
+{
+    // Cell color is playerID+1.
+    const auto & playerIDs = _summaries.back().playerIDs;
+    for (unsigned int i = 0; i < playerIDs.size(); i++)
+        if (playerIDs[i] + 1 == color)
+            return i;
+    return -1;
+}
+
+void MatchTable::append(const std::string & logFilename, const MatchSummary & summary)
+{
+    if (_logFilenames.empty() || _logFilenames.back() != logFilename)
+        _logFilenames.push_back(logFilename);
+
+    for (unsigned int i = 0; i < summary.playerIDs.size(); i++)
+    {
+        _logIndices.push_back(_logFilenames.size() - 1);
+        _gameIndices.push_back(summary.gameIndex);
+        _nbTurns.push_back(summary.nbTurns);
+        _leadChanges.push_back(summary.leadChanges);
+        _isComplete.push_back(summary.isComplete);
+        _playerIDs.push_back(summary.playerIDs[i]);
+        _nicknames.push_back(summary.nicknames[i]);
+        _ranks.push_back(summary.ranks[i]);
+        _finalScores.push_back(summary.finalScores[i]);
+        _finalCellCounts.push_back(summary.finalCellCounts[i]);
+        _bombsPlaced.push_back(summary.bombsPlaced[i]);
+        _explosionAreas.push_back(summary.explosionAreas[i]);
+        _deaths.push_back(summary.deaths[i]);
+    }
+}
+
+/// Write a CSV field, quoted as RFC 4180 (file names and nicknames may contain commas or quotes).
+static void writeCSVString(FILE * f, const std::string & str)
+{
+    fputc('"', f);
+    for (char c : str)
+    {
+        if (c == '"')
+            fputc('"', f);
+        fputc(c, f);
+    }
+    fputc('"', f);
+}
+
+bool MatchTable::exportCSV(const std::string & filename) const
+{
+    FILE * f = fopen(filename.c_str(), "w");
+    if (f == nullptr)
+        return false;
+
+    fprintf(f, "log,game,turns,complete,lead_changes,player_id,nickname,rank,"
+        "final_score,final_cell_count,bombs_placed,explosion_area,deaths\n");
+
+    for (int row = 0; row < nbRows(); row++)
+    {
+        writeCSVString(f, _logFilenames[_logIndices[row]]);
+        fprintf(f, ",%d,%d,%d,%d,%d,", _gameIndices[row], _nbTurns[row], _isComplete[row], _leadChanges[row], _playerIDs[row]);
+        writeCSVString(f, _nicknames[row]);
+        fprintf(f, ",%d,%d,%d,%d,%d,%d\n", _ranks[row], _finalScores[row], _finalCellCounts[row],
+            _bombsPlaced[row], _explosionAreas[row], _deaths[row]);
+    }
+
+    return fclose(f) == 0;
+}
@@ -0,0 +1,102 @@
+#pragma once
+
+#include <map>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <netorcai-client-cpp/message.hpp>
+
+#include "hexabomb-parse.hpp"
+#include "stats.hpp"
+
+/// The outcome of one recorded game, for each of its players.
+struct MatchSummary
+{
+    int gameIndex = 0; //!< Index of the game in its log, from 0.
+    int nbTurns = 0; //!< Number of turns played.
+    int leadChanges = 0; //!< Number of times the score leader changed. Turns with a tie have no leader.
+    bool isComplete = false; //!< Whether the game ended (GAME_ENDS was recorded).
+
+    std::vector<int> playerIDs;
+    std::vector<std::string> nicknames;
+    std::vector<int> ranks; //!< 1 for the best score. Tied players share their rank.
+    std::vector<int> finalScores;
+    std::vector<int> finalCellCounts;
+    std::vector<int> bombsPlaced;
+    std::vector<int> explosionAreas; //!< Cells exploded by the player bombs during the whole game.
+    std::vector<int> deaths; //!< Number of times a character of the player died.
+};
+
+/**
+ * @brief Summarize the games of a log, message after message
+ * @details Game states are parsed into the same structures as the renderer's (parseGameState, StatsStore),
+ *          so that both agree on what a bomb placement or an explosion is.
+ */
+class MatchAnalyzer
+{
+public:
+    /// Handle the next message of the log. Other messages than GAME_STARTS, TURN and GAME_ENDS are ignored.
+    void onMessage(const netorcai::json & message);
+
+    /// Summarize the last game even if its GAME_ENDS was not recorded (e.g. truncated log).
+    void finishLog();
+
+    /// The games summarized so far.
+    const std::vector<MatchSummary> & summaries() const { return _summaries; }
+
+private:
+    void onGameStarts(const netorcai::json & message);
+    void onGameState(const netorcai::json & gameState, int nbTurns);
+    void finishGame();
+    int playerIndexFromColor(int color) const;
+
+private:
+    std::vector<MatchSummary> _summaries;
+    bool _inGame = false;
+
+    std::unordered_map<Coordinates, Cell> _cells;
+    std::vector<Character> _characters;
+    std::vector<Bomb> _bombs;
+    std::unordered_map<int, std::vector<Coordinates> > _explosions;
+    std::map<int, int> _score;
+    std::map<int, int> _cellCount;
+
+    StatsStore _stats;
+    std::unordered_map<int, bool> _wasAlive; //!< Whether each character (by id) was alive last turn.
+    int _leader = -1; //!< Player index of the current score leader, -1 until there is one.
+};
+
+/**
+ * @brief The summaries of many games, stored column by column
+ * @details One row per player of each game, in the order games are appended.
+ */
+class MatchTable
+{
+public:
+    void append(const std::string & logFilename, const MatchSummary & summary);
+
+    int nbRows() const { return _playerIDs.size(); }
+
+    /**
+     * @brief Write all rows in a CSV file
+     * @return Whether the file could be written
+     */
+    bool exportCSV(const std::string & filename) const;
+
+private:
+    std::vector<std::string> _logFilenames; //!< One per appended game.
+    std::vector<int> _logIndices; //!< Index in _logFilenames of each row.
+    std::vector<int> _gameIndices;
+    std::vector<int> _nbTurns;
+    std::vector<int> _leadChanges;
+    std::vector<int> _isComplete;
+    std::vector<int> _playerIDs;
+    std::vector<std::string> _nicknames;
+    std::vector<int> _ranks;
+    std::vector<int> _finalScores;
+    std::vector<int> _finalCellCounts;
+    std::vector<int> _bombsPlaced;
+    std::vector<int> _explosionAreas;
+    std::vector<int> _deaths;
+};
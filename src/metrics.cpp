@@ -0,0 +1,207 @@
+#include "metrics.hpp"
+
+#include <stdio.h>
+
+#include <SFML/Network.hpp>
+
+#include "util.hpp"
+
+const double MetricHistogram::bucketBounds[MetricHistogram::NB_BUCKETS] =
+    {0.001, 0.0025, 0.005, 0.01, 0.025, 0.05, 0.1, 0.25, 0.5, 1.0, 2.5, 10.0};
+
+void MetricHistogram::observe(int64_t microseconds)
+{
+    const double seconds = microseconds / 1e6;
+    int bucket = 0;
+    while (bucket < NB_BUCKETS && seconds > bucketBounds[bucket])
+        bucket++;
+
+    _buckets[bucket].fetch_add(1, std::memory_order_relaxed);
+    _sumMicroseconds.fetch_add(microseconds > 0 ? microseconds : 0, std::memory_order_relaxed);
+}
+
+void MetricHistogram::write(std::string & out, const char * name, const std::string & labels) const
+{
+    const std::string separator = labels.empty() ? "" : ",";
+    char line[256];
+
+    uint64_t count = 0;
+    for (int bucket = 0; bucket <= NB_BUCKETS; bucket++)
+    {
+        count += _buckets[bucket].load(std::memory_order_relaxed);
+        if (bucket < NB_BUCKETS)
+            snprintf(line, sizeof(line), "%s_bucket{%s%sle=\"%g\"} %llu\n", name, labels.c_str(), separator.c_str(),
+                bucketBounds[bucket], (unsigned long long) count);
+        else
+            snprintf(line, sizeof(line), "%s_bucket{%s%sle=\"+Inf\"} %llu\n", name, labels.c_str(), separator.c_str(),
+                (unsigned long long) count);
+        out += line;
+    }
+
+    const std::string braces = labels.empty() ? "" : "{" + labels + "}";
+    snprintf(line, sizeof(line), "%s_sum%s %g\n%s_count%s %llu\n",
+        name, braces.c_str(), _sumMicroseconds.load(std::memory_order_relaxed) / 1e6,
+        name, braces.c_str(), (unsigned long long) count);
+    out += line;
+}
+
+void Metrics::setNbGames(int nbGames)
+{
+    _games.clear();
+    for (int i = 0; i < nbGames; i++)
+        _games.emplace_back(new GameMetrics);
+}
+
+/// Append the HELP and TYPE lines of a metric.
+static void writeHeader(std::string & out, const char * name, const char * type, const char * help)
+{
+    out += std::string("# HELP ") + name + " " + help + "\n";
+    out += std::string("# TYPE ") + name + " " + type + "\n";
+}
+
+std::string Metrics::exposition() const
+{
+    std::string out;
+    char line[256];
+
+    writeHeader(out, "hexabomb_visu_frame_seconds", "histogram", "Time between two frames drawn back to back.");
+    frameTime.write(out, "hexabomb_visu_frame_seconds", "");
+
+    writeHeader(out, "hexabomb_visu_resident_memory_bytes", "gauge", "Resident memory of the process.");
+    snprintf(line, sizeof(line), "hexabomb_visu_resident_memory_bytes %zu\n", residentMemoryBytes());
+    out += line;
+
+    // Per-game metrics, labeled by the index of the game in the window.
+    struct CounterMetric { const char * name; const char * type; const char * help; MetricCounter GameMetrics::*counter; };
+    static const CounterMetric counters[] = {
+        {"hexabomb_visu_turns_received_total", "counter", "TURN messages received.", &GameMetrics::turnsReceived},
+        {"hexabomb_visu_turns_dropped_total", "counter", "TURN messages skipped because the renderer was late.", &GameMetrics::turnsDropped},
+        {"hexabomb_visu_playout_dropped_total", "counter", "TURN messages recorded but not shown because the playout buffer was behind.", &GameMetrics::playoutDropped},
+    };
+    for (const auto & metric : counters)
+    {
+        writeHeader(out, metric.name, metric.type, metric.help);
+        for (unsigned int i = 0; i < _games.size(); i++)
+        {
+            snprintf(line, sizeof(line), "%s{game=\"%u\"} %llu\n", metric.name, i,
+                (unsigned long long) ((*_games[i]).*metric.counter).value());
+            out += line;
+        }
+    }
+
+    // Pushed and popped are read separately: The difference may be off by one message during a scrape.
+    writeHeader(out, "hexabomb_visu_queue_depth", "gauge", "Messages waiting in the renderer queue.");
+    for (unsigned int i = 0; i < _games.size(); i++)
+    {
+        const uint64_t popped = _games[i]->messagesPopped.value();
+        const uint64_t pushed = _games[i]->messagesPushed.value();
+        snprintf(line, sizeof(line), "hexabomb_visu_queue_depth{game=\"%u\"} %lld\n", i,
+            (long long) (pushed > popped ? pushed - popped : 0));
+        out += line;
+    }
+
+    writeHeader(out, "hexabomb_visu_game_number", "gauge", "Number of games started in this window.");
+    for (unsigned int i = 0; i < _games.size(); i++)
+    {
+        snprintf(line, sizeof(line), "hexabomb_visu_game_number{game=\"%u\"} %lld\n", i, (long long) _games[i]->gameNumber.value());
+        out += line;
+    }
+
+    writeHeader(out, "hexabomb_visu_turn_number", "gauge", "Turn of the current game.");
+    for (unsigned int i = 0; i < _games.size(); i++)
+    {
+        snprintf(line, sizeof(line), "hexabomb_visu_turn_number{game=\"%u\"} %lld\n", i, (long long) _games[i]->turnNumber.value());
+        out += line;
+    }
+
+    writeHeader(out, "hexabomb_visu_playout_depth", "gauge", "Messages held by the playout buffer.");
+    for (unsigned int i = 0; i < _games.size(); i++)
+    {
+        snprintf(line, sizeof(line), "hexabomb_visu_playout_depth{game=\"%u\"} %lld\n", i, (long long) _games[i]->playoutDepth.value());
+        out += line;
+    }
+
+    writeHeader(out, "hexabomb_visu_playout_delay_seconds", "histogram", "Time a TURN was held by the playout buffer.");
+    for (unsigned int i = 0; i < _games.size(); i++)
+        _games[i]->playoutDelay.write(out, "hexabomb_visu_playout_delay_seconds", "game=\"" + std::to_string(i) + "\"");
+
+    writeHeader(out, "hexabomb_visu_turn_ack_seconds", "histogram", "Time from the reception of a TURN to its TURN_ACK.");
+    for (unsigned int i = 0; i < _games.size(); i++)
+        _games[i]->turnAckLatency.write(out, "hexabomb_visu_turn_ack_seconds", "game=\"" + std::to_string(i) + "\"");
+
+    writeHeader(out, "hexabomb_visu_turn_display_seconds", "histogram", "Time from the reception of a TURN to the display of its frame.");
+    for (unsigned int i = 0; i < _games.size(); i++)
+        _games[i]->turnDisplayLatency.write(out, "hexabomb_visu_turn_display_seconds", "game=\"" + std::to_string(i) + "\"");
+
+    return out;
+}
+
+Metrics & metrics()
+{
+    static Metrics instance;
+    return instance;
+}
+
+/**
+ * @brief Answer one HTTP request
+ * @details Requests are small: Only the request line matters. Clients that do not send it quickly are dropped.
+ */
+static void serveClient(sf::TcpSocket & client)
+{
+    sf::SocketSelector selector;
+    selector.add(client);
+
+    std::string request;
+    char buffer[1024];
+    while (request.find("\r\n\r\n") == std::string::npos && request.size() < 8192)
+    {
+        size_t received = 0;
+        if (!selector.wait(sf::milliseconds(500)) || client.receive(buffer, sizeof(buffer), received) != sf::Socket::Done)
+            return;
+        request.append(buffer, received);
+    }
+
+    std::string status = "200 OK";
+    std::string body;
+    if (request.compare(0, 13, "GET /metrics ") == 0 || request.compare(0, 6, "GET / ") == 0)
+        body = metrics().exposition();
+    else
+    {
+        status = "404 Not Found";
+        body = "Not found. Metrics are served at /metrics\n";
+    }
+
+    const std::string response = "HTTP/1.0 " + status + "\r\n"
+        "Content-Type: text/plain; version=0.0.4\r\n"
+        "Content-Length: " + std::to_string(body.size()) + "\r\n"
+        "Connection: close\r\n\r\n" + body;
+    client.send(response.data(), response.size());
+}
+
+void metrics_thread_function(boost::lockfree::queue<Message> * from_main, uint16_t port)
+{
+    sf::TcpListener listener;
+    if (listener.listen(port, sf::IpAddress::LocalHost) != sf::Socket::Done)
+    {
+        printf("Cannot serve metrics on port %d\n", port); fflush(stdout);
+        return;
+    }
+    printf("Serving metrics on http://localhost:%d/metrics\n", port); fflush(stdout);
+
+    sf::SocketSelector selector;
+    selector.add(listener);
+
+    for (;;)
+    {
+        Message msg;
+        if (from_main->pop(msg) && msg.type == MessageType::TERMINATE)
+            break;
+
+        if (selector.wait(sf::milliseconds(100)))
+        {
+            sf::TcpSocket client;
+            if (listener.accept(client) == sf::Socket::Done)
+                serveClient(client);
+        }
+    }
+}
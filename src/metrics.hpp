@@ -0,0 +1,103 @@
+#pragma once
+
+#include <stdint.h>
+
+#include <atomic>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <boost/lockfree/queue.hpp>
+
+#include "threads.hpp"
+
+/**
+ * @brief A monotonic counter, updated without locks
+ * @details Each metric is written by a single thread (relaxed atomics on its own cache line),
+ *          and read by the metrics thread when it is scraped.
+ */
+class alignas(64) MetricCounter
+{
+public:
+    void add(uint64_t n = 1) { _value.fetch_add(n, std::memory_order_relaxed); }
+    uint64_t value() const { return _value.load(std::memory_order_relaxed); }
+
+private:
+    std::atomic<uint64_t> _value{0};
+};
+
+/// A value that goes up and down, updated without locks. See MetricCounter.
+class alignas(64) MetricGauge
+{
+public:
+    void set(int64_t value) { _value.store(value, std::memory_order_relaxed); }
+    int64_t value() const { return _value.load(std::memory_order_relaxed); }
+
+private:
+    std::atomic<int64_t> _value{0};
+};
+
+/**
+ * @brief A histogram of durations with fixed buckets, updated without locks
+ * @details Buckets range from 1 ms to 10 s, which covers frames, turns and acknowledgements.
+ */
+class alignas(64) MetricHistogram
+{
+public:
+    static const int NB_BUCKETS = 12;
+    static const double bucketBounds[NB_BUCKETS]; //!< Upper bounds of the buckets, in seconds.
+
+    void observe(int64_t microseconds);
+
+    /// Append the histogram in Prometheus text format, with the given labels (e.g. game="0") if not empty.
+    void write(std::string & out, const char * name, const std::string & labels) const;
+
+private:
+    std::atomic<uint64_t> _buckets[NB_BUCKETS + 1] = {}; //!< Not cumulative. The last one is +Inf.
+    std::atomic<uint64_t> _sumMicroseconds{0};
+};
+
+/// The metrics of one watched game. Network metrics are written by its network thread, the others by the renderer thread.
+struct GameMetrics
+{
+    MetricCounter turnsReceived;
+    MetricCounter turnsDropped; //!< Turns not forwarded to the renderer because it was late.
+    MetricCounter messagesPushed; //!< Messages pushed to the renderer queue.
+    MetricCounter messagesPopped; //!< Messages popped from the renderer queue.
+    MetricHistogram turnAckLatency; //!< From the reception of a TURN to its TURN_ACK.
+    MetricHistogram turnDisplayLatency; //!< From the reception of a TURN to the display of the frame that shows it.
+    MetricGauge gameNumber; //!< Number of games started in this window.
+    MetricGauge turnNumber;
+    MetricGauge playoutDepth; //!< Messages held by the playout buffer of the renderer.
+    MetricHistogram playoutDelay; //!< From the reception of a TURN to its release by the playout buffer.
+    MetricCounter playoutDropped; //!< Turns the playout buffer did not show, as a newer turn was due or it was full.
+};
+
+/// The metrics of the process.
+class Metrics
+{
+public:
+    /// Create the metrics of nbGames games. Must be called before the threads start.
+    void setNbGames(int nbGames);
+    GameMetrics & game(int index) { return *_games[index]; }
+
+    MetricHistogram frameTime; //!< Time between two displayed frames.
+
+    /// The metrics in Prometheus text exposition format (version 0.0.4).
+    std::string exposition() const;
+
+private:
+    std::vector<std::unique_ptr<GameMetrics> > _games;
+};
+
+/// The process-wide metrics.
+Metrics & metrics();
+
+/**
+ * @brief Serve the metrics over HTTP on localhost (GET /metrics)
+ * @param from_main A TERMINATE message stops the thread.
+ * @param port The local TCP port
+ * @details Runs on its own thread, which only reads metrics: Scrapes never wait for rendering.
+ *          One request is served at a time, and slow clients are disconnected.
+ */
+void metrics_thread_function(boost::lockfree::queue<Message> * from_main, uint16_t port);
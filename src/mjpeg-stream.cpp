@@ -0,0 +1,275 @@
+#include "mjpeg-stream.hpp"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <list>
+
+#include <jpeglib.h>
+#include <SFML/Network.hpp>
+
+/// A client of the stream.
+struct StreamClient
+{
+    sf::TcpSocket socket;
+    std::string request; //!< Received until the end of the HTTP request headers.
+    bool isStreaming = false; //!< Whether the request has been received. The client is then sent frames.
+    std::shared_ptr<const std::string> data; //!< What is being sent (headers or a frame), if anything.
+    size_t nbSent = 0; //!< Bytes of data already sent.
+    uint64_t partNumber = 0; //!< The frame number of the last frame sent.
+};
+
+static const char streamHeaders[] =
+    "HTTP/1.0 200 OK\r\n"
+    "Content-Type: multipart/x-mixed-replace; boundary=frame\r\n"
+    "Cache-Control: no-cache\r\n"
+    "Connection: close\r\n\r\n";
+
+/**
+ * @brief Compress RGBA pixels to JPEG
+ * @details libjpeg reports errors by exiting the process. With valid sizes, it can only run out of memory.
+ */
+static void encodeJpeg(const sf::Uint8 * pixels, unsigned int width, unsigned int height, int quality,
+    std::vector<sf::Uint8> & rowBuffer, std::string & jpeg)
+{
+    jpeg_compress_struct compressor;
+    jpeg_error_mgr errorManager;
+    compressor.err = jpeg_std_error(&errorManager);
+    jpeg_create_compress(&compressor);
+
+    unsigned char * buffer = nullptr;
+    unsigned long size = 0;
+    jpeg_mem_dest(&compressor, &buffer, &size);
+
+    compressor.image_width = width;
+    compressor.image_height = height;
+#ifdef JCS_EXTENSIONS
+    // libjpeg-turbo reads RGBA rows as they are.
+    compressor.input_components = 4;
+    compressor.in_color_space = JCS_EXT_RGBA;
+#else
+    compressor.input_components = 3;
+    compressor.in_color_space = JCS_RGB;
+    rowBuffer.resize(width * 3);
+#endif
+    jpeg_set_defaults(&compressor);
+    jpeg_set_quality(&compressor, quality, TRUE);
+    jpeg_start_compress(&compressor, TRUE);
+
+    while (compressor.next_scanline < height)
+    {
+        const sf::Uint8 * rgba = pixels + (size_t) compressor.next_scanline * width * 4;
+#ifdef JCS_EXTENSIONS
+        JSAMPROW row = const_cast<JSAMPROW>(rgba);
+#else
+        for (unsigned int x = 0; x < width; x++)
+        {
+            rowBuffer[3*x] = rgba[4*x];
+            rowBuffer[3*x+1] = rgba[4*x+1];
+            rowBuffer[3*x+2] = rgba[4*x+2];
+        }
+        JSAMPROW row = rowBuffer.data();
+#endif
+        jpeg_write_scanlines(&compressor, &row, 1);
+    }
+
+    jpeg_finish_compress(&compressor);
+    jpeg.assign((const char *) buffer, size);
+    free(buffer);
+    jpeg_destroy_compress(&compressor);
+}
+
+MjpegStream::MjpegStream(uint16_t port, int nbEncoders, int quality) :
+    _quality(quality),
+    _framePool(nbEncoders + 2)
+{
+    for (int i = 0; i < nbEncoders; i++)
+        _encoders.emplace_back(&MjpegStream::encoderLoop, this);
+    _server = std::thread(&MjpegStream::serverLoop, this, port);
+}
+
+MjpegStream::~MjpegStream()
+{
+    _shouldQuit = true;
+    _serverWakeup.notify();
+    _server.join();
+    for (auto & encoder : _encoders)
+    {
+        _encodersWakeup.notify();
+        encoder.join();
+    }
+
+    _framePool.release(_pendingFrame);
+}
+
+void MjpegStream::publish(const sf::Uint8 * pixels, unsigned int width, unsigned int height)
+{
+    RawFrame * frame = _framePool.acquire();
+    frame->number = ++_nbPublished;
+    frame->width = width;
+    frame->height = height;
+    frame->pixels.assign(pixels, pixels + (size_t) width * height * 4);
+
+    {
+        std::lock_guard<std::mutex> lock(_pendingMutex);
+        std::swap(frame, _pendingFrame);
+    }
+
+    // The replaced frame, if any, was never encoded: The encoders are busy.
+    _framePool.release(frame);
+    _encodersWakeup.notify();
+}
+
+void MjpegStream::encoderLoop()
+{
+    std::vector<sf::Uint8> rowBuffer;
+    std::string jpeg;
+    char partHeaders[128];
+
+    while (!_shouldQuit)
+    {
+        RawFrame * frame = nullptr;
+        {
+            std::lock_guard<std::mutex> lock(_pendingMutex);
+            std::swap(frame, _pendingFrame);
+        }
+        if (frame == nullptr)
+        {
+            _encodersWakeup.waitFor(100000);
+            continue;
+        }
+
+        encodeJpeg(frame->pixels.data(), frame->width, frame->height, _quality, rowBuffer, jpeg);
+        const uint64_t number = frame->number;
+        _framePool.release(frame);
+
+        // Headers and frame are sent as one buffer, shared by all clients.
+        const int headersSize = snprintf(partHeaders, sizeof(partHeaders),
+            "--frame\r\nContent-Type: image/jpeg\r\nContent-Length: %zu\r\n\r\n", jpeg.size());
+        auto part = std::make_shared<std::string>();
+        part->reserve(headersSize + jpeg.size() + 2);
+        part->append(partHeaders, headersSize);
+        part->append(jpeg);
+        part->append("\r\n");
+
+        // Encoders may finish out of order: Only a newer frame replaces the current one.
+        {
+            std::lock_guard<std::mutex> lock(_partMutex);
+            if (number > _partNumber)
+            {
+                _partNumber = number;
+                _part = std::move(part);
+            }
+        }
+        _serverWakeup.notify();
+    }
+}
+
+void MjpegStream::serverLoop(uint16_t port)
+{
+    sf::TcpListener listener;
+    if (listener.listen(port, sf::IpAddress::LocalHost) != sf::Socket::Done)
+    {
+        printf("Cannot stream frames on port %d\n", port); fflush(stdout);
+        return;
+    }
+    printf("Streaming frames on http://localhost:%d/\n", port); fflush(stdout);
+    listener.setBlocking(false);
+
+    const auto headers = std::make_shared<const std::string>(streamHeaders);
+    std::list<std::unique_ptr<StreamClient> > clients;
+    auto client = std::make_unique<StreamClient>();
+    while (!_shouldQuit)
+    {
+        while (listener.accept(client->socket) == sf::Socket::Done)
+        {
+            client->socket.setBlocking(false);
+            clients.push_back(std::move(client));
+            client = std::make_unique<StreamClient>();
+        }
+
+        std::shared_ptr<const std::string> part;
+        uint64_t partNumber = 0;
+        {
+            std::lock_guard<std::mutex> lock(_partMutex);
+            part = _part;
+            partNumber = _partNumber;
+        }
+
+        // Send what can be sent without blocking. Clients only get the latest frame once the previous one is sent.
+        // isPolling tells whether a client waits for its socket rather than for the next frame.
+        bool isPolling = false;
+        for (auto it = clients.begin(); it != clients.end(); )
+        {
+            StreamClient & c = **it;
+            bool isConnected = true;
+
+            if (!c.isStreaming)
+            {
+                // Any request is answered with the stream.
+                char buffer[1024];
+                size_t received = 0;
+                const sf::Socket::Status status = c.socket.receive(buffer, sizeof(buffer), received);
+                if (status == sf::Socket::Done)
+                {
+                    c.request.append(buffer, received);
+                    if (c.request.find("\r\n\r\n") != std::string::npos)
+                    {
+                        c.isStreaming = true;
+                        c.data = headers;
+                        c.nbSent = 0;
+                        _nbClients++;
+                        _frameRequested = true;
+                        printf("Stream client connected (%s)\n", c.socket.getRemoteAddress().toString().c_str());
+                        fflush(stdout);
+                    }
+                    else if (c.request.size() > 8192)
+                        isConnected = false;
+                }
+                else if (status == sf::Socket::NotReady)
+                    isPolling = true;
+                else
+                    isConnected = false;
+            }
+
+            if (isConnected && c.isStreaming)
+            {
+                if (c.data == nullptr && part != nullptr && partNumber > c.partNumber)
+                {
+                    c.data = part;
+                    c.nbSent = 0;
+                    c.partNumber = partNumber;
+                }
+
+                if (c.data != nullptr)
+                {
+                    size_t sent = 0;
+                    const sf::Socket::Status status = c.socket.send(c.data->data() + c.nbSent, c.data->size() - c.nbSent, sent);
+                    c.nbSent += sent;
+                    if (status == sf::Socket::Done)
+                        c.data = nullptr;
+                    else if (status == sf::Socket::Partial || status == sf::Socket::NotReady)
+                        isPolling = true;
+                    else
+                        isConnected = false;
+                }
+            }
+
+            if (isConnected)
+                ++it;
+            else
+            {
+                if (c.isStreaming)
+                {
+                    _nbClients--;
+                    printf("Stream client disconnected (%s)\n", c.socket.getRemoteAddress().toString().c_str());
+                    fflush(stdout);
+                }
+                it = clients.erase(it);
+            }
+        }
+
+        // Poll sockets quickly while they are busy, otherwise wait for the next frame or client.
+        _serverWakeup.waitFor(isPolling ? 2000 : 50000);
+    }
+}
@@ -0,0 +1,84 @@
+#pragma once
+
+#include <stdint.h>
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <SFML/Graphics.hpp>
+
+#include "object-pool.hpp"
+#include "wakeup.hpp"
+
+/**
+ * @brief Publishes frames as an MJPEG stream (multipart/x-mixed-replace) on a local HTTP port
+ * @details Frames are compressed by encoder threads, and sent to clients by a server thread.
+ *          publish() never waits: A frame that no encoder has taken yet is replaced by the next one.
+ *          Clients never slow the others down either: Each one is sent the latest frame once it has
+ *          received the previous one, and misses the frames encoded in between.
+ */
+class MjpegStream
+{
+public:
+    /**
+     * @brief Start serving the stream
+     * @param port The local TCP port, e.g. http://localhost:port/ in a browser
+     * @param nbEncoders The number of encoder threads
+     * @param quality The JPEG quality, from 1 to 100
+     */
+    MjpegStream(uint16_t port, int nbEncoders, int quality);
+    ~MjpegStream();
+
+    MjpegStream(const MjpegStream &) = delete;
+    MjpegStream & operator=(const MjpegStream &) = delete;
+
+    /// Whether a client watches the stream. Frames are not worth publishing otherwise.
+    bool hasClients() const { return _nbClients > 0; }
+
+    /**
+     * @brief Whether a client connected since the last call
+     * @details Frames are only published when something changed: A new client needs one anyway.
+     */
+    bool takeFrameRequest() { return _frameRequested.exchange(false); }
+
+    /// Encode a frame and send it to the clients. The pixels (RGBA, as sf::Image) are copied.
+    void publish(const sf::Uint8 * pixels, unsigned int width, unsigned int height);
+    void publish(const sf::Image & image) { publish(image.getPixelsPtr(), image.getSize().x, image.getSize().y); }
+
+private:
+    /// A frame waiting for an encoder.
+    struct RawFrame
+    {
+        uint64_t number = 0;
+        unsigned int width = 0;
+        unsigned int height = 0;
+        std::vector<sf::Uint8> pixels;
+    };
+
+    void encoderLoop();
+    void serverLoop(uint16_t port);
+
+private:
+    const int _quality;
+    std::atomic<bool> _shouldQuit{false};
+    std::atomic<int> _nbClients{0};
+    std::atomic<bool> _frameRequested{false};
+
+    uint64_t _nbPublished = 0; //!< Only accessed by the publishing thread.
+    ObjectPool<RawFrame> _framePool;
+    std::mutex _pendingMutex;
+    RawFrame * _pendingFrame = nullptr; //!< The latest frame that no encoder has taken yet, if any.
+    Wakeup _encodersWakeup;
+
+    std::mutex _partMutex;
+    uint64_t _partNumber = 0; //!< The frame number of _part.
+    std::shared_ptr<const std::string> _part; //!< The latest encoded frame, with its multipart headers.
+    Wakeup _serverWakeup;
+
+    std::vector<std::thread> _encoders;
+    std::thread _server;
+};
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <stddef.h>
+
+#include <boost/lockfree/queue.hpp>
+
+/**
+ * @brief A thread-safe free list of heap objects, so that messages are reused instead of reallocated
+ * @details Objects are acquired by one thread and released by another (e.g. network and renderer threads).
+ *          Released objects keep the capacity of their members (vectors, strings), so that refilling
+ *          them does not allocate once the pool is warm. Objects released when the pool is full are deleted.
+ */
+template <typename T>
+class ObjectPool
+{
+public:
+    /// Create a pool that keeps up to capacity released objects.
+    explicit ObjectPool(size_t capacity) : _free(capacity) {}
+
+    ~ObjectPool()
+    {
+        T * object;
+        while (_free.pop(object))
+            delete object;
+    }
+
+    ObjectPool(const ObjectPool &) = delete;
+    ObjectPool & operator=(const ObjectPool &) = delete;
+
+    /// Get a released object, or a new one if there is none. Its content is the one it was released with.
+    T * acquire()
+    {
+        T * object = nullptr;
+        if (_free.pop(object))
+            return object;
+        return new T;
+    }
+
+    /// Give an object back to the pool. Does nothing on nullptr.
+    void release(T * object)
+    {
+        if (object != nullptr && !_free.bounded_push(object))
+            delete object;
+    }
+
+private:
+    boost::lockfree::queue<T*> _free;
+};
@@ -0,0 +1,82 @@
+#include "playout-buffer.hpp"
+
+#include <math.h>
+
+#include <algorithm>
+#include <limits>
+
+#include "util.hpp"
+
+void PlayoutBuffer::push(const Message & msg)
+{
+    const int64_t arrival = msg.receivedMicroseconds > 0 ? msg.receivedMicroseconds : monotonicMicroseconds();
+
+    // A new game starts a new pace.
+    if (msg.type == MessageType::GAME_STARTS)
+    {
+        _lastArrivalMicroseconds = 0;
+        _intervalMicroseconds = 0;
+        _jitterMicroseconds = 0;
+    }
+
+    int64_t release = std::max(arrival, _lastReleaseMicroseconds);
+    if (msg.type == MessageType::TURN)
+    {
+        if (_lastArrivalMicroseconds > 0)
+        {
+            const double interval = arrival - _lastArrivalMicroseconds;
+            if (_intervalMicroseconds == 0)
+                _intervalMicroseconds = interval;
+            else
+            {
+                _jitterMicroseconds += _gain * (fabs(interval - _intervalMicroseconds) - _jitterMicroseconds);
+                _intervalMicroseconds += _gain * (interval - _intervalMicroseconds);
+            }
+        }
+        _lastArrivalMicroseconds = arrival;
+
+        const int64_t delay = _jitterFactor * _jitterMicroseconds;
+        const int64_t spacing = _spacingFactor * _intervalMicroseconds;
+        release = std::max(arrival + delay, _lastReleaseMicroseconds + spacing);
+        release = std::min(release, arrival + _maxDelayMicroseconds);
+        release = std::max(release, _lastReleaseMicroseconds);
+    }
+
+    _lastReleaseMicroseconds = release;
+    _entries.push_back(Entry{msg, release});
+}
+
+bool PlayoutBuffer::pop(Message & msg, int64_t nowMicroseconds, bool & isOverdue)
+{
+    if (_entries.empty())
+        return false;
+
+    // Only turns are overdue: Other messages are always shown, in order.
+    const Entry & front = _entries.front();
+    const bool isFull = (int) _entries.size() > _maxDepth;
+    const bool isNextDue = _entries.size() > 1 && _entries[1].msg.type == MessageType::TURN
+        && _entries[1].releaseMicroseconds <= nowMicroseconds;
+    isOverdue = front.msg.type == MessageType::TURN && (isFull || isNextDue);
+    if (front.releaseMicroseconds > nowMicroseconds && !isOverdue)
+        return false;
+
+    msg = front.msg;
+    _entries.pop_front();
+    if (msg.type == MessageType::TURN && !isOverdue && msg.receivedMicroseconds > 0)
+        _lastDelayMicroseconds = nowMicroseconds - msg.receivedMicroseconds;
+    return true;
+}
+
+int64_t PlayoutBuffer::nextReleaseMicroseconds() const
+{
+    if (_entries.empty())
+        return std::numeric_limits<int64_t>::max();
+    return _entries.front().releaseMicroseconds;
+}
+
+void PlayoutBuffer::clear()
+{
+    for (auto & entry : _entries)
+        delete_message_data(entry.msg);
+    _entries.clear();
+}
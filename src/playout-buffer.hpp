@@ -0,0 +1,67 @@
+#pragma once
+
+#include <stdint.h>
+
+#include <deque>
+
+#include "threads.hpp"
+
+/**
+ * @brief Holds the messages of a game for a short while, so that turns are displayed at a steady pace
+ * @details Turns arrive unevenly, as players answer at their own pace. The buffer estimates the mean
+ *          interval between turns and its jitter (mean deviation, as RTP receivers do), and delays each
+ *          turn by twice the jitter. Turns that arrive together are spaced by most of the mean interval.
+ *          The delay follows the jitter, so the buffer only gets deeper while arrivals are irregular, and
+ *          no turn is ever held longer than maxDelay. Other messages are released right after the turns before them.
+ *          Turns that are overdue, as a newer turn is due as well or the buffer is full, are released to be
+ *          recorded but not shown, so that the display catches up with the game.
+ */
+class PlayoutBuffer
+{
+public:
+    /// Set the longest time a turn may be held. 0 releases every message as soon as it is pushed.
+    void setMaxDelay(int64_t microseconds) { _maxDelayMicroseconds = microseconds; }
+
+    /// Hold a message. Its receivedMicroseconds is its arrival time.
+    void push(const Message & msg);
+
+    /**
+     * @brief Release the oldest message if it is due
+     * @param isOverdue Set if msg is a TURN that should not be shown: A newer TURN follows it and is due as well,
+     *        or the buffer holds more than maxDepth messages (the TURN is then released before it is due).
+     * @return Whether a message has been released into msg
+     */
+    bool pop(Message & msg, int64_t nowMicroseconds, bool & isOverdue);
+
+    /// When the oldest message is due (see monotonicMicroseconds), or INT64_MAX if there is none.
+    int64_t nextReleaseMicroseconds() const;
+
+    int depth() const { return _entries.size(); }
+
+    /// How long the last released turn has been held, in microseconds.
+    int64_t lastDelayMicroseconds() const { return _lastDelayMicroseconds; }
+
+    /// Release the data of the held messages, e.g. when the window closes.
+    void clear();
+
+private:
+    struct Entry
+    {
+        Message msg;
+        int64_t releaseMicroseconds;
+    };
+
+    std::deque<Entry> _entries;
+    int64_t _maxDelayMicroseconds = 0;
+
+    int64_t _lastArrivalMicroseconds = 0; //!< Arrival of the last turn of the game, 0 before the first one.
+    int64_t _lastReleaseMicroseconds = 0; //!< Release time of the last scheduled message.
+    double _intervalMicroseconds = 0; //!< Smoothed interval between turn arrivals.
+    double _jitterMicroseconds = 0; //!< Smoothed deviation of the intervals from _intervalMicroseconds.
+    int64_t _lastDelayMicroseconds = 0;
+
+    const double _gain = 1.0 / 16; //!< Weight of each new interval in the estimates (as in RFC 3550).
+    const double _jitterFactor = 2.0; //!< Turns are delayed by this many jitters.
+    const double _spacingFactor = 0.75; //!< Turns are released at least this many intervals apart.
+    const int _maxDepth = 32; //!< Beyond this many messages, the oldest turns are overdue, so that the buffer stays bounded.
+};
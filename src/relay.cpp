@@ -0,0 +1,562 @@
+#include "relay.hpp"
+
+#include <deque>
+#include <list>
+#include <memory>
+
+#include <SFML/Network.hpp>
+
+#include <netorcai-client-cpp/message.hpp>
+
+#include "hexabomb-parse.hpp"
+#include "metrics.hpp"
+#include "turn-digest.hpp"
+#include "util.hpp"
+
+using namespace netorcai;
+
+enum class RelayPacketType : sf::Uint8
+{
+    GAME_STARTS, //!< Full game state, sent when the game starts or when a viewer joins.
+    TURN,        //!< Game state delta.
+    GAME_ENDS,   //!< Game state delta.
+    KICK         //!< The relay lost netorcai.
+};
+
+/// The game as seen by the relay.
+struct RelayedGame
+{
+    bool started = false;
+    int nbPlayers = 0;
+    int nbSpecialPlayers = 0;
+    int nbTurnsMax = 0;
+    std::vector<PlayerInfo> playersInfo;
+
+    std::unordered_map<Coordinates, Cell> cells;
+    std::vector<Character> characters;
+    std::vector<Bomb> bombs;
+    std::unordered_map<int, std::vector<Coordinates> > explosions;
+    std::map<int, int> score, cellCount;
+
+    std::unordered_map<Coordinates, int> sentColors; //!< The cell colors viewers know about.
+    std::vector<Cell> changedCells; //!< Reused across turns.
+};
+
+/// A viewer connected to the relay.
+struct Viewer
+{
+    sf::TcpSocket socket;
+    std::deque<sf::Packet> pending; //!< Packets not fully sent yet. The front one may be partially sent.
+};
+
+static const size_t maxPendingPacketsPerViewer = 64;
+static const int64_t exitFlushMicroseconds = 300000; //!< How long viewers may take to receive the end of the game at exit.
+
+static void writeCoordinates(sf::Packet & packet, const Coordinates & coord)
+{
+    packet << (sf::Int16) coord.q << (sf::Int16) coord.r;
+}
+
+static Coordinates readCoordinates(sf::Packet & packet)
+{
+    sf::Int16 q = 0, r = 0;
+    packet >> q >> r;
+
+    Coordinates coord;
+    coord.q = q;
+    coord.r = r;
+    return coord;
+}
+
+static void writePlayersInfo(sf::Packet & packet, const std::vector<PlayerInfo> & playersInfo)
+{
+    packet << (sf::Uint16) playersInfo.size();
+    for (const auto & info : playersInfo)
+        packet << (sf::Int32) info.playerID << info.nickname << info.remoteAddress << info.isConnected;
+}
+
+static std::vector<PlayerInfo> readPlayersInfo(sf::Packet & packet)
+{
+    sf::Uint16 nbPlayers = 0;
+    packet >> nbPlayers;
+
+    std::vector<PlayerInfo> playersInfo(nbPlayers);
+    for (auto & info : playersInfo)
+    {
+        sf::Int32 playerID = 0;
+        packet >> playerID >> info.nickname >> info.remoteAddress >> info.isConnected;
+        info.playerID = playerID;
+    }
+
+    return playersInfo;
+}
+
+static void writePlayerIntMap(sf::Packet & packet, const std::map<int, int> & m)
+{
+    packet << (sf::Uint16) m.size();
+    for (const auto & [playerID, value] : m)
+        packet << (sf::Int16) playerID << (sf::Int32) value;
+}
+
+static json readPlayerIntMap(sf::Packet & packet)
+{
+    json object = json::object();
+
+    sf::Uint16 size = 0;
+    packet >> size;
+    for (int i = 0; i < size; i++)
+    {
+        sf::Int16 playerID = 0;
+        sf::Int32 value = 0;
+        packet >> playerID >> value;
+        object[std::to_string(playerID)] = value;
+    }
+
+    return object;
+}
+
+/**
+ * @brief Serialize the game state of a relayed game
+ * @param[in, out] packet The packet to append to
+ * @param[in, out] game The relayed game. Its sent colors are updated.
+ * @param[in] keyframe Whether all cells should be sent, or only those whose color changed.
+ */
+static void writeGameState(sf::Packet & packet, RelayedGame & game, bool keyframe)
+{
+    game.changedCells.clear();
+    for (const auto & [coord, cell] : game.cells)
+    {
+        auto it = game.sentColors.find(coord);
+        if (it == game.sentColors.end())
+            it = game.sentColors.emplace(coord, -1).first;
+
+        if (keyframe || it->second != cell.color)
+        {
+            game.changedCells.push_back(Cell{coord, cell.color});
+            it->second = cell.color;
+        }
+    }
+
+    packet << (sf::Uint32) game.changedCells.size();
+    for (const auto & cell : game.changedCells)
+    {
+        writeCoordinates(packet, cell.coord);
+        packet << (sf::Int16) cell.color;
+    }
+
+    packet << (sf::Uint32) game.characters.size();
+    for (const auto & character : game.characters)
+    {
+        packet << (sf::Int32) character.id;
+        writeCoordinates(packet, character.coord);
+        packet << (sf::Int16) character.color << character.isAlive << (sf::Int16) character.reviveDelay;
+    }
+
+    packet << (sf::Uint32) game.bombs.size();
+    for (const auto & bomb : game.bombs)
+    {
+        writeCoordinates(packet, bomb.coord);
+        packet << (sf::Int16) bomb.color << (sf::Int16) bomb.range << (sf::Int16) bomb.delay;
+    }
+
+    packet << (sf::Uint16) game.explosions.size();
+    for (const auto & [color, coords] : game.explosions)
+    {
+        packet << (sf::Int16) color << (sf::Uint32) coords.size();
+        for (const auto & coord : coords)
+            writeCoordinates(packet, coord);
+    }
+
+    writePlayerIntMap(packet, game.score);
+    writePlayerIntMap(packet, game.cellCount);
+}
+
+static sf::Packet makeGameStartsPacket(RelayedGame & game)
+{
+    sf::Packet packet;
+    packet << (sf::Uint8) RelayPacketType::GAME_STARTS;
+    packet << (sf::Int32) game.nbPlayers << (sf::Int32) game.nbSpecialPlayers << (sf::Int32) game.nbTurnsMax;
+    writePlayersInfo(packet, game.playersInfo);
+    writeGameState(packet, game, true);
+    return packet;
+}
+
+/// Try to send the pending packets of a viewer. Returns false if the viewer should be dropped.
+static bool flushViewer(Viewer & viewer)
+{
+    while (!viewer.pending.empty())
+    {
+        const sf::Socket::Status status = viewer.socket.send(viewer.pending.front());
+        if (status == sf::Socket::Done)
+            viewer.pending.pop_front();
+        else if (status == sf::Socket::Partial || status == sf::Socket::NotReady)
+            return true;
+        else
+            return false;
+    }
+
+    return true;
+}
+
+void relay_thread_function(boost::lockfree::queue<Message> * from_network, uint16_t port)
+{
+    RelayedGame game;
+    std::list<std::unique_ptr<Viewer> > viewers;
+
+    sf::TcpListener listener;
+    if (listener.listen(port, sf::IpAddress::LocalHost) != sf::Socket::Done)
+        printf("Relay: cannot listen on port %d, viewers will not be served\n", port);
+    else
+        printf("Relay: listening on port %d\n", port);
+    fflush(stdout);
+    listener.setBlocking(false);
+
+    auto broadcast = [&viewers](const sf::Packet & packet)
+    {
+        for (auto & viewer : viewers)
+            viewer->pending.push_back(packet);
+    };
+
+    bool shouldQuit = false;
+    auto viewer = std::make_unique<Viewer>();
+    while (!shouldQuit)
+    {
+        bool idle = true;
+
+        // Accept new viewers. They first receive the whole current state.
+        while (listener.accept(viewer->socket) == sf::Socket::Done)
+        {
+            printf("Relay: viewer connected (%s)\n", viewer->socket.getRemoteAddress().toString().c_str());
+            fflush(stdout);
+
+            viewer->socket.setBlocking(false);
+            if (game.started)
+                viewer->pending.push_back(makeGameStartsPacket(game));
+            viewers.push_back(std::move(viewer));
+            viewer = std::make_unique<Viewer>();
+            idle = false;
+        }
+
+        // Encode what has been received from netorcai.
+        Message msg;
+        while (from_network->pop(msg))
+        {
+            idle = false;
+            sf::Packet packet;
+
+            if (msg.type == MessageType::GAME_STARTS)
+            {
+                auto gameStarts = (GameStartsMessage *) msg.data;
+                game = RelayedGame();
+                game.started = true;
+                game.nbPlayers = gameStarts->nbPlayers;
+                game.nbSpecialPlayers = gameStarts->nbSpecialPlayers;
+                game.nbTurnsMax = gameStarts->nbTurnsMax;
+                game.playersInfo = gameStarts->playersInfo;
+                parseGameState(gameStarts->initialGameState, game.cells, game.characters, game.bombs, game.explosions, game.score, game.cellCount);
+                broadcast(makeGameStartsPacket(game));
+            }
+            else if (msg.type == MessageType::TURN)
+            {
+                auto turn = (TurnMessage *) msg.data;
+                game.playersInfo = turn->playersInfo;
+                parseGameState(turn->gameState, game.cells, game.characters, game.bombs, game.explosions, game.score, game.cellCount);
+
+                packet << (sf::Uint8) RelayPacketType::TURN << (sf::Int32) turn->turnNumber;
+                writePlayersInfo(packet, turn->playersInfo);
+                writeGameState(packet, game, false);
+                broadcast(packet);
+            }
+            else if (msg.type == MessageType::GAME_ENDS)
+            {
+                auto gameEnds = (GameEndsMessage *) msg.data;
+                parseGameState(gameEnds->gameState, game.cells, game.characters, game.bombs, game.explosions, game.score, game.cellCount);
+
+                packet << (sf::Uint8) RelayPacketType::GAME_ENDS << (sf::Int32) gameEnds->winnerPlayerID;
+                writeGameState(packet, game, false);
+                broadcast(packet);
+            }
+            else if (msg.type == MessageType::ERROR)
+            {
+                packet << (sf::Uint8) RelayPacketType::KICK << std::string((char *) msg.data);
+                broadcast(packet);
+            }
+            else if (msg.type == MessageType::TERMINATE)
+                shouldQuit = true;
+
+            delete_message_data(msg);
+        }
+
+        // Send what can be sent without blocking. Drop viewers that cannot keep up.
+        for (auto it = viewers.begin(); it != viewers.end(); )
+        {
+            auto & v = **it;
+            if (!flushViewer(v) || v.pending.size() > maxPendingPacketsPerViewer)
+            {
+                printf("Relay: viewer dropped (%s)\n", v.socket.getRemoteAddress().toString().c_str());
+                fflush(stdout);
+                it = viewers.erase(it);
+            }
+            else
+            {
+                if (!v.pending.empty())
+                    idle = false;
+                ++it;
+            }
+        }
+
+        if (idle)
+            sf::sleep(sf::milliseconds(2));
+    }
+
+    // Give viewers a last chance to receive the end of the game, without blocking on those that stopped reading.
+    // What they have not received by the deadline is dropped.
+    const int64_t deadlineMicroseconds = monotonicMicroseconds() + exitFlushMicroseconds;
+    while (!viewers.empty() && monotonicMicroseconds() < deadlineMicroseconds)
+    {
+        for (auto it = viewers.begin(); it != viewers.end(); )
+        {
+            if (!flushViewer(**it) || (*it)->pending.empty())
+                it = viewers.erase(it);
+            else
+                ++it;
+        }
+        if (!viewers.empty())
+            sf::sleep(sf::milliseconds(2));
+    }
+}
+
+/// What a viewer knows about the game, to rebuild netorcai messages from deltas.
+struct ViewerState
+{
+    /// Cells changed since the last message forwarded to the renderer.
+    /// The renderer may skip turns, but it must not miss cell changes.
+    std::unordered_map<Coordinates, int> pendingCells;
+};
+
+static json readGameState(sf::Packet & packet, ViewerState & state)
+{
+    json gameState;
+
+    // The cells of the game state are the changes of this packet only (see flushPendingCells).
+    gameState["cells"] = json::array();
+    sf::Uint32 nbCells = 0;
+    packet >> nbCells;
+    for (sf::Uint32 i = 0; i < nbCells && packet; i++)
+    {
+        const Coordinates coord = readCoordinates(packet);
+        sf::Int16 color = 0;
+        packet >> color;
+        state.pendingCells[coord] = color;
+        gameState["cells"].push_back({{"q", coord.q}, {"r", coord.r}, {"color", color}});
+    }
+
+    gameState["characters"] = json::array();
+    sf::Uint32 nbCharacters = 0;
+    packet >> nbCharacters;
+    for (sf::Uint32 i = 0; i < nbCharacters && packet; i++)
+    {
+        sf::Int32 id = 0;
+        sf::Int16 color = 0, reviveDelay = 0;
+        bool isAlive = false;
+        packet >> id;
+        const Coordinates coord = readCoordinates(packet);
+        packet >> color >> isAlive >> reviveDelay;
+
+        gameState["characters"].push_back({{"id", id}, {"q", coord.q}, {"r", coord.r},
+            {"color", color}, {"alive", isAlive}, {"revive_delay", reviveDelay}});
+    }
+
+    gameState["bombs"] = json::array();
+    sf::Uint32 nbBombs = 0;
+    packet >> nbBombs;
+    for (sf::Uint32 i = 0; i < nbBombs && packet; i++)
+    {
+        sf::Int16 color = 0, range = 0, delay = 0;
+        const Coordinates coord = readCoordinates(packet);
+        packet >> color >> range >> delay;
+
+        gameState["bombs"].push_back({{"q", coord.q}, {"r", coord.r},
+            {"color", color}, {"range", range}, {"delay", delay}});
+    }
+
+    gameState["explosions"] = json::object();
+    sf::Uint16 nbExplosionColors = 0;
+    packet >> nbExplosionColors;
+    for (int i = 0; i < nbExplosionColors && packet; i++)
+    {
+        sf::Int16 color = 0;
+        sf::Uint32 nbCoords = 0;
+        packet >> color >> nbCoords;
+
+        json coords = json::array();
+        for (sf::Uint32 j = 0; j < nbCoords && packet; j++)
+        {
+            const Coordinates coord = readCoordinates(packet);
+            coords.push_back({{"q", coord.q}, {"r", coord.r}});
+        }
+        gameState["explosions"][std::to_string(color)] = coords;
+    }
+
+    gameState["score"] = readPlayerIntMap(packet);
+    gameState["cell_count"] = readPlayerIntMap(packet);
+
+    return gameState;
+}
+
+/// Move the cell changes the renderer does not know about yet into a game state.
+static void flushPendingCells(ViewerState & state, json & gameState)
+{
+    json cells = json::array();
+    for (const auto & [coord, color] : state.pendingCells)
+        cells.push_back({{"q", coord.q}, {"r", coord.r}, {"color", color}});
+    state.pendingCells.clear();
+
+    gameState["cells"] = cells;
+}
+
+void viewer_network_thread_function(boost::lockfree::queue<Message> * from_renderer,
+    boost::lockfree::queue<Message> * to_renderer,
+    const std::string & hostname, uint16_t port,
+    bool persistent,
+    GameMetrics * gameMetrics)
+{
+    // Forward a message to the renderer.
+    auto push = [to_renderer, gameMetrics](const Message & msg)
+    {
+        to_renderer->push(msg);
+        gameMetrics->messagesPushed.add();
+        renderer_wakeup().notify();
+    };
+
+    sf::TcpSocket socket;
+    ViewerState state;
+    TurnDigester digester;
+    Message msg;
+    bool shouldQuit = false;
+
+    printf("Connecting to relay (%s:%d)... ", hostname.c_str(), port); fflush(stdout);
+    if (socket.connect(hostname, port, sf::seconds(5)) != sf::Socket::Done)
+    {
+        printf("failed\n");
+
+        msg.type = MessageType::ERROR;
+        asprintf((char**)&msg.data, "cannot connect to relay %s:%d", hostname.c_str(), port);
+        push(msg);
+        return;
+    }
+    printf("done\n");
+
+    sf::SocketSelector selector;
+    selector.add(socket);
+
+    while (!shouldQuit)
+    {
+        if (selector.wait(sf::milliseconds(5)))
+        {
+            sf::Packet packet;
+            msg.receivedMicroseconds = monotonicMicroseconds();
+            if (socket.receive(packet) != sf::Socket::Done)
+            {
+                msg.type = MessageType::ERROR;
+                asprintf((char**)&msg.data, "connection to relay lost");
+                printf("Connection to relay lost\n"); fflush(stdout);
+                push(msg);
+                break;
+            }
+
+            sf::Uint8 type = 0;
+            packet >> type;
+
+            if (type == (sf::Uint8) RelayPacketType::GAME_STARTS)
+            {
+                printf("Received GAME_STARTS\n"); fflush(stdout);
+                state = ViewerState();
+
+                auto gameStarts = new GameStartsMessage;
+                sf::Int32 nbPlayers = 0, nbSpecialPlayers = 0, nbTurnsMax = 0;
+                packet >> nbPlayers >> nbSpecialPlayers >> nbTurnsMax;
+                gameStarts->playerID = -1;
+                gameStarts->nbPlayers = nbPlayers;
+                gameStarts->nbSpecialPlayers = nbSpecialPlayers;
+                gameStarts->nbTurnsMax = nbTurnsMax;
+                gameStarts->msBeforeFirstTurn = 0;
+                gameStarts->msBetweenTurns = 0;
+                gameStarts->playersInfo = readPlayersInfo(packet);
+                gameStarts->initialGameState = readGameState(packet, state);
+                flushPendingCells(state, gameStarts->initialGameState);
+                digester.reset(gameStarts->initialGameState);
+
+                msg.type = MessageType::GAME_STARTS;
+                msg.data = (void*) gameStarts;
+                push(msg);
+            }
+            else if (type == (sf::Uint8) RelayPacketType::TURN)
+            {
+                sf::Int32 turnNumber = 0;
+                packet >> turnNumber;
+                std::vector<PlayerInfo> playersInfo = readPlayersInfo(packet);
+                json gameState = readGameState(packet, state);
+
+                // Only forward TURN if the queue is empty, as the network thread does.
+                // Cell changes of skipped turns are kept and sent with the next forwarded turn.
+                if (to_renderer->empty())
+                {
+                    digester.track(gameState);
+                    auto turn = turn_message_pool().acquire();
+                    turn->turnNumber = turnNumber;
+                    turn->playersInfo = std::move(playersInfo);
+                    turn->gameState = std::move(gameState);
+                    flushPendingCells(state, turn->gameState);
+
+                    msg.type = MessageType::TURN;
+                    msg.data = (void*) turn;
+                }
+                else
+                {
+                    msg.type = MessageType::SKIPPED_TURN;
+                    msg.data = (void*) digester.digest(turnNumber, gameState);
+                    gameMetrics->turnsDropped.add();
+                }
+                push(msg);
+                gameMetrics->turnsReceived.add();
+            }
+            else if (type == (sf::Uint8) RelayPacketType::GAME_ENDS)
+            {
+                printf("Received GAME_ENDS\n"); fflush(stdout);
+                auto gameEnds = new GameEndsMessage;
+                sf::Int32 winnerPlayerID = -1;
+                packet >> winnerPlayerID;
+                gameEnds->winnerPlayerID = winnerPlayerID;
+                gameEnds->gameState = readGameState(packet, state);
+                flushPendingCells(state, gameEnds->gameState);
+
+                msg.type = MessageType::GAME_ENDS;
+                msg.data = (void*) gameEnds;
+                push(msg);
+                shouldQuit = !persistent;
+            }
+            else if (type == (sf::Uint8) RelayPacketType::KICK)
+            {
+                std::string reason;
+                packet >> reason;
+                msg.type = MessageType::ERROR;
+                asprintf((char**)&msg.data, "%s", reason.c_str());
+                printf("Relay lost netorcai. Reason: %s\n", reason.c_str());
+                fflush(stdout);
+                push(msg);
+                shouldQuit = true;
+            }
+        }
+
+        // Look whether termination has been requested.
+        if (!from_renderer->empty())
+        {
+            Message msg;
+            from_renderer->pop(msg);
+
+            if (msg.type == MessageType::TERMINATE)
+                shouldQuit = true;
+        }
+    }
+}
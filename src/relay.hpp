@@ -0,0 +1,32 @@
+#pragma once
+
+#include <stdint.h>
+
+#include <string>
+
+#include <boost/lockfree/queue.hpp>
+
+#include "threads.hpp"
+
+/**
+ * @brief Re-broadcast a game to viewer hexabomb-visu instances
+ * @param from_network The messages received by the network thread (GAME_STARTS, TURN, GAME_ENDS, ERROR).
+ *        The relay owns their data. A TERMINATE message stops the relay.
+ * @param port The local TCP port on which viewers connect
+ * @details The relay sends compact binary deltas: Only the cells whose color changed are sent each turn.
+ *          Viewers that join during a game first receive the full current state.
+ *          Slow viewers are disconnected rather than slowing the relay down.
+ */
+void relay_thread_function(boost::lockfree::queue<Message> * from_network, uint16_t port);
+
+/**
+ * @brief Receive a game from a relaying hexabomb-visu instead of netorcai
+ * @details Same interface as network_thread_function. The renderer receives the usual messages.
+ *          If persistent, the games relayed one after the other are received until TERMINATE.
+ *          There is no TURN_ACK to a relay: Only the other network metrics are updated.
+ */
+void viewer_network_thread_function(boost::lockfree::queue<Message> * from_renderer,
+    boost::lockfree::queue<Message> * to_renderer,
+    const std::string & hostname, uint16_t port,
+    bool persistent,
+    GameMetrics * gameMetrics);
@@ -0,0 +1,104 @@
+#include "render-benchmark.hpp"
+
+#include <stdio.h>
+
+#include <random>
+
+#include <SFML/Graphics.hpp>
+
+#include "renderer.hpp"
+#include "software-canvas.hpp"
+
+int render_benchmark(int boardRadius, int nbFrames, const RendererOptions & options)
+{
+    const unsigned int width = 1280;
+    const unsigned int height = 720;
+    const int nbPlayers = 4;
+
+    // A full board, randomly colored, with characters and bombs scattered on it.
+    std::mt19937 random(42);
+    std::unordered_map<Coordinates, Cell> cells;
+    std::vector<Character> characters;
+    std::vector<Bomb> bombs;
+    std::map<int, int> score, cellCount;
+    for (int q = -boardRadius; q <= boardRadius; q++)
+    {
+        for (int r = std::max(-boardRadius, -q - boardRadius); r <= std::min(boardRadius, -q + boardRadius); r++)
+        {
+            const Coordinates coord{q, r};
+            const int color = random() % (nbPlayers + 1);
+            cells[coord] = Cell{coord, color};
+            if (color > 0)
+                cellCount[color - 1]++;
+
+            if (color > 0 && random() % 50 == 0)
+                characters.push_back(Character{(int) characters.size(), coord, color, true, -1});
+            else if (color > 0 && random() % 50 == 0)
+                bombs.push_back(Bomb{coord, color, 3, 2});
+        }
+    }
+
+    std::vector<netorcai::PlayerInfo> playersInfo;
+    for (int id = 0; id < nbPlayers; id++)
+    {
+        playersInfo.push_back(netorcai::PlayerInfo{id, "player" + std::to_string(id), "", true});
+        score[id] = cellCount[id];
+    }
+
+    Assets assets(options.searchAssets);
+    while (!assets.poll())
+        sf::sleep(sf::milliseconds(1));
+
+    ThreadPool threadPool(options.nbThreads);
+    HexabombRenderer renderer(assets);
+    renderer.setThreadPool(&threadPool);
+    renderer.updateView(width, height);
+    renderer.onGameInit(cells, characters, bombs, score, cellCount, 100, playersInfo);
+    printf("Benchmarking %d frames of %ux%u pixels, %zu cells, %d worker threads\n",
+        nbFrames, width, height, cells.size(), threadPool.size());
+
+    sf::RenderTexture renderTexture;
+    if (!renderTexture.create(width, height))
+    {
+        printf("Cannot create the OpenGL render texture\n");
+        return 1;
+    }
+
+    sf::Image glFrame;
+    sf::Clock clock;
+    for (int frame = 0; frame < nbFrames; frame++)
+    {
+        renderTexture.clear(sf::Color::Black);
+        renderer.draw(renderTexture);
+        renderTexture.display();
+        glFrame = renderTexture.getTexture().copyToImage();
+    }
+    const float glMs = clock.getElapsedTime().asSeconds() * 1000.f / nbFrames;
+
+    // As in the render loop: Texts are drawn from a copy of the font textures.
+    assets.freezeFont(HexabombRenderer::characterSizes());
+    SoftwareCanvas canvas;
+    canvas.setThreadPool(&threadPool);
+    canvas.setFontImages(&assets);
+    canvas.create(width, height);
+    clock.restart();
+    for (int frame = 0; frame < nbFrames; frame++)
+    {
+        canvas.clear(sf::Color::Black);
+        renderer.draw(canvas);
+    }
+    const float softwareMs = clock.getElapsedTime().asSeconds() * 1000.f / nbFrames;
+
+    printf("OpenGL:   %8.2f ms/frame\n", glMs);
+    printf("Software: %8.2f ms/frame\n", softwareMs);
+
+    if (!options.framesDirectory.empty())
+    {
+        glFrame.saveToFile(options.framesDirectory + "/benchmark-opengl.png");
+        canvas.saveToFile(options.framesDirectory + "/benchmark-software.png");
+        printf("Last frames written to %s\n", options.framesDirectory.c_str());
+    }
+    fflush(stdout);
+
+    return 0;
+}
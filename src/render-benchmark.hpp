@@ -0,0 +1,15 @@
+#pragma once
+
+#include "threads.hpp"
+
+/**
+ * @brief Time the OpenGL and software renderers on the same synthetic board, and print the results
+ * @param boardRadius The radius of the hexagonal board, in cells
+ * @param nbFrames The number of frames drawn by each renderer
+ * @param options The renderer options (number of threads, assets search)
+ * @details Frames are 1280x720. The OpenGL frames are read back to main memory, as offline
+ *          jobs do with the software frames. The last frame of each renderer is saved
+ *          as a PNG image into options.framesDirectory, if any.
+ * @return The process exit code
+ */
+int render_benchmark(int boardRadius, int nbFrames, const RendererOptions & options);
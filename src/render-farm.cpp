@@ -0,0 +1,287 @@
+#include "render-farm.hpp"
+
+#include <stdio.h>
+
+#include <atomic>
+#include <thread>
+
+#include <boost/filesystem.hpp>
+#include <boost/lockfree/queue.hpp>
+
+#include <SFML/Graphics.hpp>
+
+#include "game-log.hpp"
+#include "object-pool.hpp"
+#include "renderer.hpp"
+#include "software-canvas.hpp"
+#include "util.hpp"
+#include "wakeup.hpp"
+
+namespace fs = boost::filesystem;
+using namespace netorcai;
+
+static const unsigned int frameWidth = 1280;
+static const unsigned int frameHeight = 720;
+static const float spritePixelSize = 48.f; //!< The size the shared sprite atlas is rasterized at, whatever the board size.
+
+/// A rendered frame on its way to an encoder.
+struct FarmFrame
+{
+    std::string filename;
+    std::vector<sf::Uint8> pixels; //!< RGBA, row by row (same layout as sf::Image).
+};
+
+/// What the render and encode workers share.
+struct RenderFarm
+{
+    RenderFarm(const Assets & assets, const SpriteAtlas & atlas, const std::vector<std::string> & logFilenames,
+        int queueCapacity, int nbFramesMax) :
+        assets(assets), atlas(atlas), logFilenames(logFilenames), toEncoders(queueCapacity), framePool(nbFramesMax) {}
+
+    const Assets & assets;
+    const SpriteAtlas & atlas; //!< Rasterized once for all renderers, without texture.
+    const std::vector<std::string> & logFilenames;
+    std::string framesDirectory;
+    std::atomic<int> nextLog{0}; //!< The index of the next log to render.
+
+    boost::lockfree::queue<FarmFrame *> toEncoders; //!< Bounded: Renderers wait when it is full.
+    ObjectPool<FarmFrame> framePool; //!< Frames keep their pixel buffer from one use to the next.
+    Wakeup encodersWakeup; //!< Notified when a frame is queued, and when rendering is over.
+    Wakeup renderersWakeup; //!< Notified when a frame is written.
+    std::atomic<bool> renderingDone{false};
+
+    std::atomic<int> nbGames{0};
+    std::atomic<int> nbFrames{0}; //!< Frames written.
+    std::atomic<int> nbErrors{0};
+    std::atomic<int64_t> waitMicroseconds{0}; //!< Time renderers spent waiting for a free place in the queue.
+};
+
+/// The game a render worker is drawing.
+struct FarmGame
+{
+    std::unordered_map<Coordinates, Cell> cells;
+    std::vector<Character> characters;
+    std::vector<Bomb> bombs;
+    std::unordered_map<int, std::vector<Coordinates> > explosions;
+    std::map<int, int> score, cellCount;
+    std::vector<PlayerInfo> playersInfo;
+    int nbTurnsMax = -1;
+    bool initialized = false;
+
+    /// Forget the current game. Buffers keep their memory for the next game.
+    void reset()
+    {
+        cells.clear();
+        characters.clear();
+        bombs.clear();
+        explosions.clear();
+        score.clear();
+        cellCount.clear();
+        nbTurnsMax = -1;
+        initialized = false;
+    }
+};
+
+/// Replace the characters the frozen font does not have, so that renderers never add glyphs to the shared font.
+static void keepPrintableNicknames(std::vector<PlayerInfo> & playersInfo)
+{
+    for (auto & player : playersInfo)
+    {
+        for (char & c : player.nickname)
+        {
+            if (c < ' ' || c > '~')
+                c = '?';
+        }
+    }
+}
+
+/// Hand a copy of the canvas to the encoders. Waits if they are too far behind.
+static void queueFrame(RenderFarm & farm, const SoftwareCanvas & canvas, const std::string & filename)
+{
+    FarmFrame * frame = farm.framePool.acquire();
+    frame->filename = filename;
+    const sf::Uint8 * pixels = canvas.getPixelsPtr();
+    frame->pixels.assign(pixels, pixels + (size_t) frameWidth * frameHeight * 4);
+
+    if (!farm.toEncoders.bounded_push(frame))
+    {
+        const int64_t startMicroseconds = monotonicMicroseconds();
+        while (!farm.toEncoders.bounded_push(frame))
+            farm.renderersWakeup.waitFor(10000);
+        farm.waitMicroseconds += monotonicMicroseconds() - startMicroseconds;
+    }
+    farm.encodersWakeup.notify();
+}
+
+/// Render the logs one after the other, until there is no log left.
+static void renderWorker(RenderFarm & farm)
+{
+    HexabombRenderer renderer(farm.assets);
+    renderer.setSharedAtlas(&farm.atlas);
+    renderer.updateView(frameWidth, frameHeight);
+    SoftwareCanvas canvas;
+    canvas.create(frameWidth, frameHeight);
+    canvas.setFontImages(&farm.assets);
+    FarmGame game;
+
+    for (int index = farm.nextLog++; index < (int) farm.logFilenames.size(); index = farm.nextLog++)
+    {
+        const std::string & logFilename = farm.logFilenames[index];
+        const std::string logName = fs::path(logFilename).stem().string();
+        int gameIndex = -1;
+        int frameNumber = 0;
+        std::string directory;
+
+        auto onMessage = [&](json & message)
+        {
+            const std::string & messageType = message["message_type"].get_ref<const std::string &>();
+            if (messageType == "GAME_STARTS")
+            {
+                if (game.initialized)
+                {
+                    renderer.reset();
+                    game.reset();
+                }
+                gameIndex++;
+                frameNumber = 0;
+                directory = farm.framesDirectory + "/" + logName + "-" + std::to_string(gameIndex);
+                fs::create_directories(directory);
+
+                GameStartsMessage gameStarts = parseGameStartsMessage(message);
+                keepPrintableNicknames(gameStarts.playersInfo);
+                parseGameState(gameStarts.initialGameState, game.cells, game.characters, game.bombs, game.explosions, game.score, game.cellCount);
+                game.nbTurnsMax = gameStarts.nbTurnsMax;
+                if (gameStarts.nbSpecialPlayers > 0)
+                    renderer.setSuddenDeath(true);
+                renderer.onGameInit(game.cells, game.characters, game.bombs, game.score, game.cellCount, game.nbTurnsMax, gameStarts.playersInfo);
+                game.initialized = true;
+                farm.nbGames++;
+            }
+            else if (messageType == "TURN" && game.initialized)
+            {
+                game.playersInfo = parsePlayersInfo(message["players_info"]);
+                keepPrintableNicknames(game.playersInfo);
+                parseGameState(message["game_state"], game.cells, game.characters, game.bombs, game.explosions, game.score, game.cellCount);
+                renderer.onTurn(game.cells, game.characters, game.bombs, game.explosions, game.score, game.cellCount,
+                    message["turn_number"].get<int>() + 1, game.nbTurnsMax, game.playersInfo);
+            }
+            else if (messageType == "GAME_ENDS" && game.initialized)
+            {
+                parseGameState(message["game_state"], game.cells, game.characters, game.bombs, game.explosions, game.score, game.cellCount);
+                renderer.onStatusChange("game over");
+                renderer.onTurn(game.cells, game.characters, game.bombs, game.explosions, game.score, game.cellCount, game.nbTurnsMax, game.nbTurnsMax);
+            }
+            else
+                return;
+
+            canvas.clear(sf::Color::Black);
+            renderer.draw(canvas);
+
+            char filename[32];
+            snprintf(filename, sizeof(filename), "/frame-%06d.png", frameNumber++);
+            queueFrame(farm, canvas, directory + filename);
+        };
+
+        try
+        {
+            if (!readGameLog(logFilename, onMessage))
+            {
+                printf("Cannot read %s\n", logFilename.c_str());
+                farm.nbErrors++;
+            }
+        }
+        catch (const std::exception & e)
+        {
+            printf("%s: %s\n", logFilename.c_str(), e.what());
+            farm.nbErrors++;
+        }
+        fflush(stdout);
+
+        if (game.initialized)
+        {
+            renderer.reset();
+            game.reset();
+        }
+    }
+}
+
+/// Write frames until the queue is empty and rendering is over.
+static void encodeWorker(RenderFarm & farm)
+{
+    sf::Image image;
+    for (;;)
+    {
+        FarmFrame * frame = nullptr;
+        if (!farm.toEncoders.pop(frame))
+        {
+            // Renderers are all done once renderingDone is set: The queue is then only emptied.
+            if (!farm.renderingDone)
+            {
+                farm.encodersWakeup.waitFor(10000);
+                continue;
+            }
+            if (!farm.toEncoders.pop(frame))
+                return;
+        }
+
+        image.create(frameWidth, frameHeight, frame->pixels.data());
+        if (image.saveToFile(frame->filename))
+            farm.nbFrames++;
+        else
+        {
+            printf("Cannot write frame to %s\n", frame->filename.c_str());
+            fflush(stdout);
+            farm.nbErrors++;
+        }
+
+        farm.framePool.release(frame);
+        farm.renderersWakeup.notify();
+    }
+}
+
+int render_farm(const std::vector<std::string> & logFilenames, int nbRenderWorkers, int nbEncodeWorkers,
+    const RendererOptions & options)
+{
+    Assets assets(options.searchAssets);
+    while (!assets.poll())
+        sf::sleep(sf::milliseconds(1));
+    assets.freezeFont(HexabombRenderer::characterSizes());
+
+    // Renderers draw sprites from one image in main memory: No worker resamples images or needs OpenGL for them.
+    // Sprites are drawn with the nearest texel, so the size is a compromise between small and large boards.
+    SpriteAtlas atlas;
+    atlas.rasterize(assets, spritePixelSize, false);
+
+    // A few frames per encoder absorb the jitter of encoding times.
+    // Every frame is either queued, or held by a renderer or an encoder.
+    const int queueCapacity = 4 * nbEncodeWorkers;
+    RenderFarm farm(assets, atlas, logFilenames, queueCapacity, queueCapacity + nbRenderWorkers + nbEncodeWorkers);
+    farm.framesDirectory = options.framesDirectory;
+
+    printf("Rendering %zu logs into %s with %d render workers and %d encode workers\n",
+        logFilenames.size(), options.framesDirectory.c_str(), nbRenderWorkers, nbEncodeWorkers);
+    fflush(stdout);
+
+    const int64_t startMicroseconds = monotonicMicroseconds();
+    std::vector<std::thread> renderers, encoders;
+    for (int i = 0; i < nbEncodeWorkers; i++)
+        encoders.emplace_back(encodeWorker, std::ref(farm));
+    for (int i = 0; i < nbRenderWorkers; i++)
+        renderers.emplace_back(renderWorker, std::ref(farm));
+
+    for (auto & thread : renderers)
+        thread.join();
+    farm.renderingDone = true;
+    farm.encodersWakeup.notify();
+    for (auto & thread : encoders)
+        thread.join();
+    const double seconds = (monotonicMicroseconds() - startMicroseconds) / 1e6;
+
+    printf("%d games, %d frames in %.1f s: %.1f frames/s, %.0f games/hour\n",
+        farm.nbGames.load(), farm.nbFrames.load(), seconds,
+        seconds > 0 ? farm.nbFrames / seconds : 0.0, seconds > 0 ? farm.nbGames * 3600 / seconds : 0.0);
+    printf("Render workers waited %.1f s in total for the encoders\n", farm.waitMicroseconds / 1e6);
+    fflush(stdout);
+
+    return farm.nbErrors > 0 ? 2 : 0;
+}
@@ -0,0 +1,24 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "threads.hpp"
+
+/**
+ * @brief Render recorded games to PNG frames, several games at a time, and print the throughput
+ * @param logFilenames Game logs (see GameLogWriter). Each game of each log is rendered.
+ * @param nbRenderWorkers The number of games rendered at the same time, one thread each
+ * @param nbEncodeWorkers The number of threads that compress and write frames
+ * @param options The renderer options. Frames are written into options.framesDirectory.
+ * @details One frame is drawn per message, as --export-frames does, on the CPU (see SoftwareCanvas).
+ *          Frames are 1280x720. The frames of the index-th game of a log go into a directory named
+ *          after the log and the game, e.g. frames/table-1-0/frame-000042.png.
+ *          Renderers share the decoded images, a frozen font (see Assets::freezeFont) and a sprite atlas
+ *          rasterized once, at a fixed size (see HexabombRenderer::setSharedAtlas).
+ *          Encoding is pipelined: Renderers hand their frames to the encoders through a bounded queue,
+ *          and only wait if the encoders fall behind by more than the queue.
+ * @return The process exit code
+ */
+int render_farm(const std::vector<std::string> & logFilenames, int nbRenderWorkers, int nbEncodeWorkers,
+    const RendererOptions & options);
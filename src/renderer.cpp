@@ -1,9 +1,14 @@
 #include "renderer.hpp"
 
+#include <stdio.h>
+
 #include <algorithm>
+#include <climits>
+#include <numeric>
 #include <random>
 
-#include "util.hpp"
+#include "board-kernels.hpp"
+
 
 sf::Vector2f HexabombRenderer::axialToCartesian(Coordinates axial) const
 {
@@ -16,36 +21,305 @@ sf::Vector2f HexabombRenderer::axialToCartesian(Coordinates axial) const
     return res;
 }
 
-HexabombRenderer::HexabombRenderer()
+HexabombRenderer::HexabombRenderer(const Assets & assets) :
+    _assets(assets)
+{
+    _statusText.setFont(_assets.monospaceFont);
+    _statusText.setCharacterSize(_statusCharacterSize);
+
+    _coordinatesText.setFont(_assets.monospaceFont);
+    _coordinatesText.setCharacterSize(_boardCharacterSize);
+
+    _forecastText.setFont(_assets.monospaceFont);
+    _forecastText.setCharacterSize(_boardCharacterSize);
+
+    _pInfoText.setFont(_assets.monospaceFont);
+}
+
+std::vector<unsigned int> HexabombRenderer::characterSizes()
+{
+    return {_statusCharacterSize, _piCharacterSize, _piCompactCharacterSize, _boardCharacterSize};
+}
+
+void HexabombRenderer::appendSprite(sf::Vector2f position, Assets::ImageID image)
+{
+    _sprites.push_back(Sprite{position, image});
+}
+
+void HexabombRenderer::layoutSprites()
+{
+    sf::VertexArray & vertices = _scenes[_frontScene].spriteVertices;
+    vertices.resize(atlas().isReady() ? _sprites.size() * 6 : 0);
+    layoutSprites(vertices, 0, vertices.getVertexCount() / 6);
+}
+
+void HexabombRenderer::layoutSprites(sf::VertexArray & vertices, int begin, int end)
+{
+    for (int i = begin; i < end; i++)
+    {
+        const Sprite & sprite = _sprites[i];
+
+        // Scale and origin of the full-size image, as sf::Sprite did with the 256px textures.
+        sf::Vector2f scale = _characterScale;
+        sf::Vector2f origin(_textureSize/2.f, _textureSize/2.f);
+        if (sprite.image == Assets::BOMB)
+            scale = _bombScale;
+        else if (sprite.image == Assets::EXPLOSION)
+            scale = _explosionScale;
+        else
+            origin.x = (2.f/3.f) * _textureSize;
+
+        const sf::Vector2f topLeft(sprite.position.x - origin.x * scale.x, sprite.position.y - origin.y * scale.y);
+        const sf::Vector2f size(_textureSize * scale.x, _textureSize * scale.y);
+        const sf::IntRect & rect = atlas().textureRect(sprite.image);
+        const float u0 = rect.left;
+        const float v0 = rect.top;
+        const float u1 = rect.left + rect.width;
+        const float v1 = rect.top + rect.height;
+
+        sf::Vertex * quad = &vertices[i * 6];
+        quad[0] = sf::Vertex(topLeft, sf::Vector2f(u0, v0));
+        quad[1] = sf::Vertex(topLeft + sf::Vector2f(size.x, 0.f), sf::Vector2f(u1, v0));
+        quad[2] = sf::Vertex(topLeft + sf::Vector2f(0.f, size.y), sf::Vector2f(u0, v1));
+        quad[3] = sf::Vertex(topLeft + sf::Vector2f(0.f, size.y), sf::Vector2f(u0, v1));
+        quad[4] = sf::Vertex(topLeft + sf::Vector2f(size.x, 0.f), sf::Vector2f(u1, v0));
+        quad[5] = sf::Vertex(topLeft + size, sf::Vector2f(u1, v1));
+    }
+}
+
+void HexabombRenderer::updateAtlas()
+{
+    const sf::Vector2f viewSize = _boardView.getSize();
+    if (_sharedAtlas != nullptr || viewSize.x <= 0.f || viewSize.y <= 0.f || !_assets.isReady())
+        return;
+
+    // Rasterize images at the size of the largest sprites on screen.
+    const float pixelsPerUnit = std::max(_boardViewportSize.x / viewSize.x, _boardViewportSize.y / viewSize.y);
+    const float maxScale = std::max(_characterScale.x, _explosionScale.x);
+    completeBoardJobs();
+    if (_atlas.rasterize(_assets, _textureSize * maxScale * pixelsPerUnit))
+        layoutSprites();
+}
+
+void HexabombRenderer::setHexGeometry(sf::VertexArray & vertices, int index, sf::Vector2f center, float radius) const
+{
+    sf::Vertex * hex = &vertices[index * _verticesPerHex];
+    for (int i = 0; i < 6; i++)
+    {
+        hex[3*i + 0].position = center;
+        hex[3*i + 1].position = center + _hexCorners[i] * radius;
+        hex[3*i + 2].position = center + _hexCorners[(i+1) % 6] * radius;
+    }
+}
+
+void HexabombRenderer::setHexColor(sf::VertexArray & vertices, int index, sf::Color color)
+{
+    sf::Vertex * hex = &vertices[index * _verticesPerHex];
+    for (int i = 0; i < _verticesPerHex; i++)
+        hex[i].color = color;
+}
+
+sf::Color HexabombRenderer::heatmapColor(int index) const
+{
+    const uint32_t maxCount = _heatmaps.maxCount(_overlayKind);
+    const uint32_t count = _heatmaps.count(_overlayKind, index);
+    if (count == 0 || maxCount == 0)
+        return sf::Color::White;
+
+    // Logarithmic scale, so that rare events remain visible next to hot spots.
+    const float t = log1pf(count) / log1pf(maxCount);
+
+    sf::Color hot = sf::Color(0xd7301fff);
+    if (_overlayKind == Heatmaps::PRESENCE)
+        hot = _colors[_heatmaps.dominantColor(index)];
+
+    auto mix = [t](sf::Uint8 from, sf::Uint8 to) { return (sf::Uint8)(from + t * (to - from)); };
+    return sf::Color(mix(255, hot.r), mix(255, hot.g), mix(255, hot.b));
+}
+
+void HexabombRenderer::recolorBoard()
+{
+    completeBoardJobs();
+    startBoardJobs(_scenes[_frontScene], false);
+    completeBoardJobs();
+}
+
+void HexabombRenderer::recolorCellRange(RecolorJob & job)
+{
+    const int nbColors = _colors.size();
+    job.histogram.resize(nbColors);
+
+    // Cell colors and their histogram are computed by the same kernel.
+    // Overlays color the cells themselves, so only the histogram is computed then.
+    sf::VertexArray & cellVertices = job.scene->cellVertices;
+    sf::Vertex * vertices = (_showOverlay || job.begin == job.end) ? nullptr : &cellVertices[job.begin * _verticesPerHex];
+    recolorCells(_cellDrawColors.data() + job.begin, _cellColors.data() + job.begin, job.end - job.begin,
+        _packedColors.data(), vertices, _verticesPerHex, job.histogram.data(), nbColors, job.scratch);
+
+    if (_showOverlay)
+    {
+        for (int index = job.begin; index < job.end; index++)
+            setHexColor(cellVertices, index, heatmapColor(index));
+    }
+}
+
+void HexabombRenderer::startBoardJobs(BoardScene & scene, bool withSprites)
+{
+    const int nbCells = _board.size();
+    const int nbColors = _colors.size();
+    _packedColors.resize(nbColors);
+    for (int color = 0; color < nbColors; color++)
+        _packedColors[color] = packColor(_colors[color]);
+
+    // Jobs fill disjoint ranges of the vertex arrays. Without workers, there is one job per kind.
+    const bool parallel = _threadPool != nullptr && _threadPool->size() > 0;
+    const int cellsPerJob = parallel ? _cellsPerJob : std::max(1, nbCells);
+    const int nbRecolorJobs = std::max(1, (nbCells + cellsPerJob - 1) / cellsPerJob);
+
+    _jobs.clear();
+    _recolorJobs.resize(nbRecolorJobs);
+    for (int i = 0; i < nbRecolorJobs; i++)
+    {
+        RecolorJob & job = _recolorJobs[i];
+        job.begin = std::min(nbCells, i * cellsPerJob);
+        job.end = std::min(nbCells, job.begin + cellsPerJob);
+        job.scene = &scene;
+        _jobs.push_back([this, &job]() { recolorCellRange(job); });
+    }
+
+    if (withSprites)
+    {
+        const int nbSprites = atlas().isReady() ? _sprites.size() : 0;
+        const int spritesPerJob = parallel ? _spritesPerJob : std::max(1, nbSprites);
+        sf::VertexArray & vertices = scene.spriteVertices;
+        vertices.resize(nbSprites * 6);
+        for (int begin = 0; begin < nbSprites; begin += spritesPerJob)
+        {
+            const int end = std::min(nbSprites, begin + spritesPerJob);
+            _jobs.push_back([this, &vertices, begin, end]() { layoutSprites(vertices, begin, end); });
+        }
+    }
+
+    _boardJobsPending = true;
+    if (parallel && _jobs.size() > 1)
+    {
+        // The pool runs one batch at a time, and may be shared with other renderers.
+        _threadPool->wait();
+        _threadPool->run(_jobs);
+    }
+    else
+    {
+        for (const auto & job : _jobs)
+            job();
+        _jobs.clear();
+    }
+}
+
+void HexabombRenderer::completeBoardJobs()
+{
+    if (!_boardJobsPending)
+        return;
+
+    if (!_jobs.empty())
+        _threadPool->wait();
+    finishBoardJobs();
+}
+
+void HexabombRenderer::pollBoardJobs()
+{
+    if (!_boardJobsPending)
+        return;
+
+    if (!_jobs.empty() && !_threadPool->tryWait())
+        return;
+    finishBoardJobs();
+}
+
+void HexabombRenderer::finishBoardJobs()
 {
-    _bombTexture.loadFromFile(searchImageAbsoluteFilename("bomb.png"));
-    _characterTexture.loadFromFile(searchImageAbsoluteFilename("char.png"));
-    _deadCharacterTexture.loadFromFile(searchImageAbsoluteFilename("char_dead.png"));
-    _specialCharacterTexture.loadFromFile(searchImageAbsoluteFilename("char_special.png"));
-    _explosionTexture.loadFromFile(searchImageAbsoluteFilename("explosion.png"));
+    _jobs.clear();
+    _boardJobsPending = false;
+    _sceneSerial++;
+
+    // Merge the histograms of the cell ranges.
+    const int nbColors = _colors.size();
+    _colorHistogram.assign(nbColors, 0);
+    for (const auto & job : _recolorJobs)
+    {
+        for (int color = 0; color < nbColors && color < (int)job.histogram.size(); color++)
+            _colorHistogram[color] += job.histogram[color];
+    }
+    _nbNeutralCells = (nbColors > 0) ? _colorHistogram[0] : 0;
 
-    _bombTexture.setSmooth(true);
-    _characterTexture.setSmooth(true);
+    // A turn has been built in the back scene: Show it.
+    if (_swapScenesWhenDone)
+    {
+        _frontScene = 1 - _frontScene;
+        _swapScenesWhenDone = false;
+        updateCellCount();
+    }
+}
 
-    _monospaceFont.loadFromFile(searchFontAbsoluteFilename("DejaVuSansMono.ttf"));
+bool HexabombRenderer::checkColor(int color)
+{
+    if (color >= 0 && color < (int)_colors.size())
+        return true;
 
-    _statusText.setFont(_monospaceFont);
-    _statusText.setCharacterSize(20);
-    _statusText.setFillColor(sf::Color::Black);
+    if (!_invalidColorReported)
+    {
+        printf("Invalid color %d received: Cells and characters of this color are ignored\n", color);
+        fflush(stdout);
+        _invalidColorReported = true;
+    }
+    return false;
 }
 
-HexabombRenderer::~HexabombRenderer()
+template <bool isSuddenDeath>
+void HexabombRenderer::updateCells(const std::unordered_map<Coordinates, Cell> & cells)
 {
-    for (const auto & [coord, sprite] : _cellShapes)
-        delete sprite;
+    for (const auto & [coord, cell] : cells)
+    {
+        const int index = _board.indexOf(coord);
+        if (index < 0 || !checkColor(cell.color))
+            continue;
 
-    // Draw characters
-    for (const auto & [coord, sprite] : _characterSprites)
-        delete sprite;
+        if (_cellColors[index] != cell.color)
+        {
+            _cellColors[index] = cell.color;
+            _heatmaps.addOwnerChange(index);
+        }
 
-    // Draw bombs
-    for (const auto & sprite : _bombSprites)
-        delete sprite;
+        // In sudden death, cells are only colored by the characters on them.
+        _cellDrawColors[index] = isSuddenDeath ? 0 : cell.color;
+    }
+}
+
+template <bool isSuddenDeath>
+void HexabombRenderer::updateCharacters(const std::vector<Character> & characters)
+{
+    for (const auto & character : characters)
+    {
+        const int cellIndex = _board.indexOf(character.coord);
+        if (character.isAlive && cellIndex >= 0)
+        {
+            _heatmaps.addPresence(cellIndex, character.color);
+            if (isSuddenDeath && checkColor(character.color))
+                _cellDrawColors[cellIndex] = character.color;
+        }
+
+        if (isSuddenDeath)
+        {
+            // Dead characters are hidden. Special characters have their own image.
+            if (character.isAlive)
+                appendSprite(axialToCartesian(character.coord),
+                    (character.color == 1) ? Assets::SPECIAL_CHARACTER : Assets::CHARACTER);
+        }
+        else
+        {
+            appendSprite(axialToCartesian(character.coord),
+                character.isAlive ? Assets::CHARACTER : Assets::DEAD_CHARACTER);
+        }
+    }
 }
 
 void HexabombRenderer::onGameInit(
@@ -57,52 +331,57 @@ void HexabombRenderer::onGameInit(
     int lastTurnNumber,
     const std::vector<netorcai::PlayerInfo> & playersInfo)
 {
+    completeBoardJobs();
+
     float xmin = std::numeric_limits<float>::max();
     float ymin = std::numeric_limits<float>::max();
-    float xmax = std::numeric_limits<float>::min();
-    float ymax = std::numeric_limits<float>::min();
-
-    float xminHex = xmin;
-    float yminHex = ymin;
-    float xmaxHex = xmax;
-    float ymaxHex = ymax;
-
-    generatePlayerColors(2);
+    float xmax = std::numeric_limits<float>::lowest();
+    float ymax = std::numeric_limits<float>::lowest();
 
-    _nbNeutralCells = 0;
+    // Colors are indexed by cell color, which is playerID+1 for players.
+    int nbColors = 0;
+    for (const auto & info : playersInfo)
+        nbColors = std::max(nbColors, info.playerID + 1);
+    for (const auto & character : characters)
+        nbColors = std::max(nbColors, character.color);
+    for (const auto & [coord, cell] : cells)
+        nbColors = std::max(nbColors, cell.color);
+    generatePlayerColors(nbColors);
 
-    sf::CircleShape hex(_hexBaseLength, 6);
-    sf::Vector2f hexCenter;
-    for (size_t i = 0; i < hex.getPointCount(); i++)
+    // Hexagon corners relative to their center. Same geometry as sf::CircleShape(radius, 6).
+    float hexWidth = 0.f;
+    float hexHeight = 0.f;
+    for (int i = 0; i < 6; i++)
     {
-        auto p = hex.getPoint(i);
-        hexCenter += p;
-        if (p.x < xminHex) xminHex = p.x;
-        if (p.y < yminHex) yminHex = p.y;
-        if (p.x > xmaxHex) xmaxHex = p.x;
-        if (p.y > ymaxHex) ymaxHex = p.y;
+        const float angle = i * 2.f * M_PI / 6.f - M_PI / 2.f;
+        _hexCorners[i] = sf::Vector2f(cosf(angle), sinf(angle));
+
+        hexWidth = std::max(hexWidth, 2.f * _hexBaseLength * _hexCorners[i].x);
+        hexHeight = std::max(hexHeight, 2.f * _hexBaseLength * _hexCorners[i].y);
     }
-    hexCenter = hexCenter / (float)hex.getPointCount();
-    float hexWidth = xmaxHex - xminHex;
-    float hexHeight = ymaxHex - yminHex;
 
-    for (const auto & [coord, cell] : cells)
+    _board.build(cells);
+    _coordinatesText.clear();
+    const int nbCells = _board.size();
+    _cellColors.assign(nbCells, 0);
+    _cellDrawColors.assign(nbCells, 0);
+    _heatmaps.reset(nbCells, _colors.size());
+    _borderVertices.resize(nbCells * _verticesPerHex);
+    _forecastVertices.resize(nbCells * _verticesPerHex);
+    _forecastDelays.assign(nbCells, INT_MAX);
+    _forecastCells.clear();
+    for (auto & scene : _scenes)
+        scene.cellVertices.resize(nbCells * _verticesPerHex);
+
+    for (int index = 0; index < nbCells; index++)
     {
-        auto * shape = new sf::CircleShape(_hexBaseLength, 6);
-
-        sf::Vector2f cartesian = axialToCartesian(coord);
-        shape->setPosition(cartesian);
-        shape->setOrigin(hexCenter);
-
-        int drawColor = cell.color;
-        if (_isSuddenDeath)
-            drawColor = 0;
-        shape->setFillColor(_colors[drawColor]);
-
-        _cellShapes[coord] = shape;
-
-        if (cell.color == 0)
-            _nbNeutralCells++;
+        sf::Vector2f cartesian = axialToCartesian(_board.coordinates(index));
+        setHexGeometry(_borderVertices, index, cartesian, _hexBaseLength + 2*_hexOutlineThickness);
+        for (auto & scene : _scenes)
+            setHexGeometry(scene.cellVertices, index, cartesian, _hexBaseLength);
+        setHexColor(_borderVertices, index, sf::Color::Black);
+        setHexGeometry(_forecastVertices, index, cartesian, _hexBaseLength);
+        setHexColor(_forecastVertices, index, sf::Color::Transparent);
 
         // Update bounding box
         if (cartesian.x < xmin) xmin = cartesian.x;
@@ -111,40 +390,28 @@ void HexabombRenderer::onGameInit(
         if (cartesian.y > ymax) ymax = cartesian.y;
     }
 
-    for (const auto & character : characters)
+    // The mode is fixed for the whole game: Pick the specialized update once.
+    _sprites.clear();
+    if (_isSuddenDeath)
     {
-        auto * sprite = new sf::Sprite;
-        sprite->setTexture(_characterTexture);
-        sprite->setPosition(axialToCartesian(character.coord));
-        sprite->setOrigin(sf::Vector2f(_textureSize/2.0, _textureSize/2.0));
-        sprite->setScale(_characterScale);
-        sprite->setOrigin(sf::Vector2f((2.0/3.0)*_textureSize, _textureSize/2.0));
-
-        _characterSprites[character.id] = sprite;
-        _charactersToDraw.push_back(sprite);
-
-        if (_isSuddenDeath)
-        {
-            // Change texture of special characters
-            if (character.color == 1)
-                sprite->setTexture(_specialCharacterTexture);
-
-            auto * cellSprite = _cellShapes[character.coord];
-            cellSprite->setFillColor(_colors[character.color]);
-        }
+        updateCells<true>(cells);
+        updateCharacters<true>(characters);
     }
-
-    for (const auto & bomb : bombs)
+    else
     {
-        auto * sprite = new sf::Sprite;
-        sprite->setTexture(_bombTexture);
-        sprite->setPosition(axialToCartesian(bomb.coord));
-        sprite->setOrigin(sf::Vector2f(_textureSize/2.0, _textureSize/2.0));
-        sprite->setScale(_bombScale);
-
-        _bombSprites.push_back(sprite);
+        updateCells<false>(cells);
+        updateCharacters<false>(characters);
     }
 
+    // Counters start with the game: Initial colors and positions are not events.
+    _heatmaps.reset(nbCells, _colors.size());
+    recolorBoard();
+
+    for (const auto & bomb : bombs)
+        appendSprite(axialToCartesian(bomb.coord), Assets::BOMB);
+    _bombs = bombs;
+    updateForecast();
+
     // Set view
     _boardBoundingBox = sf::FloatRect(
         xmin - hexWidth/2.f - 2*_hexOutlineThickness,
@@ -153,11 +420,22 @@ void HexabombRenderer::onGameInit(
         ymax - ymin + hexHeight + 4*_hexOutlineThickness
     );
     _boardView.reset(_boardBoundingBox);
+    _boardTextureValid = false;
+    updateAtlas();
+    layoutSprites();
 
     // Initialize misc. info
+    std::vector<int> playerIDs;
+    for (const auto & info : playersInfo)
+        playerIDs.push_back(info.playerID);
+    _stats.reset(playerIDs);
+    _stats.append(0, characters, bombs, {}, score, cellCount);
+
     _score = score;
+    _cellCount = cellCount;
+    updateCellCount();
     updatePlayerInfo(0, lastTurnNumber, playersInfo);
-    updateCellCount(cellCount);
+    onStatusChange("");
 }
 
 void HexabombRenderer::onTurn(
@@ -171,87 +449,191 @@ void HexabombRenderer::onTurn(
     int lastTurnNumber,
     const std::vector<netorcai::PlayerInfo> & playersInfo)
 {
-    _pInfoTexts.clear();
-    _pInfoRectShapes.clear();
-    _ccdRectShapes.clear();
+    // The jobs of the previous turn read the state updated here.
+    completeBoardJobs();
 
-    _nbNeutralCells = 0;
-    for (const auto & [coord, cell] : cells)
+    _sprites.clear();
+    if (_isSuddenDeath)
     {
-        auto * sprite = _cellShapes[coord];
-        int drawColor = cell.color;
-        if (_isSuddenDeath)
-            drawColor = 0;
-        sprite->setFillColor(_colors[drawColor]);
-
-        if (cell.color == 0)
-            _nbNeutralCells++;
+        updateCells<true>(cells);
+        updateCharacters<true>(characters);
     }
-
-    _charactersToDraw.resize(0);
-    for (const auto & character : characters)
+    else
     {
-        auto * sprite = _characterSprites[character.id];
-        sprite->setPosition(axialToCartesian(character.coord));
+        updateCells<false>(cells);
+        updateCharacters<false>(characters);
+    }
 
-        if (_isSuddenDeath && character.isAlive)
-        {
-            auto * cellSprite = _cellShapes[character.coord];
-            cellSprite->setFillColor(_colors[character.color]);
-        }
+    for (const auto & bomb : bombs)
+        appendSprite(axialToCartesian(bomb.coord), Assets::BOMB);
+    _bombs = bombs;
+    updateForecast();
 
-        if (!_isSuddenDeath)
+    for (const auto& [color, coordinates] : explosions)
+    {
+        for (const auto& coord : coordinates)
         {
-            // Change texture if the character alive state changed
-            auto texture = sprite->getTexture();
-            if (character.isAlive && texture != &_characterTexture)
-                sprite->setTexture(_characterTexture);
-            else if (!character.isAlive && texture != &_deadCharacterTexture)
-                sprite->setTexture(_deadCharacterTexture);
-        }
+            const int cellIndex = _board.indexOf(coord);
+            if (cellIndex >= 0)
+                _heatmaps.addExplosion(cellIndex);
 
-        // Hide dead characters in sudden death
-        if (character.isAlive || !_isSuddenDeath)
-            _charactersToDraw.push_back(sprite);
+            appendSprite(axialToCartesian(coord), Assets::EXPLOSION);
+        }
     }
 
-    for (auto * sprite : _bombSprites)
-        delete sprite;
-    _bombSprites.clear();
+    // Cells and sprites of the turn are built in the back scene by the thread pool, if any,
+    // while the front scene is still drawn. The scenes are swapped once the jobs are done.
+    // The panel is laid out on this thread meanwhile, as laying out text may update the font texture.
+    startBoardJobs(_scenes[1 - _frontScene], true);
+    _swapScenesWhenDone = true;
 
-    for (const auto & bomb : bombs)
-    {
-        auto * sprite = new sf::Sprite;
-        sprite->setTexture(_bombTexture);
-        sprite->setPosition(axialToCartesian(bomb.coord));
-        sprite->setOrigin(sf::Vector2f(_textureSize/2.0, _textureSize/2.0));
-        sprite->setScale(_bombScale);
+    // Update misc. info
+    _stats.append(currentTurnNumber, characters, bombs, explosions, score, cellCount);
+
+    _score = score;
+    _cellCount = cellCount;
+    updatePlayerInfo(currentTurnNumber, lastTurnNumber, playersInfo);
+
+    // Without workers, the jobs are already done.
+    pollBoardJobs();
+}
+
+void HexabombRenderer::onSkippedTurn(const TurnDigest & digest)
+{
+    // The board jobs read the cell colors and the heatmaps.
+    completeBoardJobs();
+    for (const auto & cell : digest.changedCells)
+        recordSkippedCell(cell.coord, cell.color);
+
+    // Numbered as in onTurn.
+    recordSkippedTurn(digest.characters, digest.bombs, digest.explosions, digest.score, digest.cellCount, digest.turnNumber + 1);
+}
 
-        _bombSprites.push_back(sprite);
+void HexabombRenderer::onSkippedTurn(
+    const std::unordered_map<Coordinates, Cell> & cells,
+    const std::vector<Character> & characters,
+    const std::vector<Bomb> & bombs,
+    const std::unordered_map<int, std::vector<Coordinates> > & explosions,
+    const std::map<int, int> & score,
+    const std::map<int, int> & cellCount,
+    int currentTurnNumber)
+{
+    completeBoardJobs();
+    // Parsed cells only have their color set: Their coordinates are the keys.
+    for (const auto & [coord, cell] : cells)
+        recordSkippedCell(coord, cell.color);
+
+    recordSkippedTurn(characters, bombs, explosions, score, cellCount, currentTurnNumber);
+}
+
+void HexabombRenderer::recordSkippedCell(const Coordinates & coord, int color)
+{
+    // Cell colors are updated too, so that the next displayed turn only counts its own changes.
+    const int index = _board.indexOf(coord);
+    if (index >= 0 && checkColor(color) && _cellColors[index] != color)
+    {
+        _cellColors[index] = color;
+        _heatmaps.addOwnerChange(index);
     }
+}
 
-    for (auto * sprite : _explosionSprites)
-        delete sprite;
-    _explosionSprites.clear();
+void HexabombRenderer::recordSkippedTurn(
+    const std::vector<Character> & characters,
+    const std::vector<Bomb> & bombs,
+    const std::unordered_map<int, std::vector<Coordinates> > & explosions,
+    const std::map<int, int> & score,
+    const std::map<int, int> & cellCount,
+    int currentTurnNumber)
+{
+    for (const auto & character : characters)
+    {
+        const int index = _board.indexOf(character.coord);
+        if (character.isAlive && index >= 0)
+            _heatmaps.addPresence(index, character.color);
+    }
 
-    for (const auto& [color, coordinates] : explosions)
+    for (const auto & [color, coordinates] : explosions)
     {
-        for (const auto& coord : coordinates)
+        for (const auto & coord : coordinates)
         {
-            auto * sprite = new sf::Sprite;
-            sprite->setTexture(_explosionTexture);
-            sprite->setPosition(axialToCartesian(coord));
-            sprite->setOrigin(sf::Vector2f(_textureSize/2.0, _textureSize/2.0));
-            sprite->setScale(_explosionScale);
-
-            _explosionSprites.push_back(sprite);
+            const int index = _board.indexOf(coord);
+            if (index >= 0)
+                _heatmaps.addExplosion(index);
         }
     }
 
-    // Update misc. info
-    _score = score;
-    updatePlayerInfo(currentTurnNumber, lastTurnNumber, playersInfo);
-    updateCellCount(cellCount);
+    _stats.append(currentTurnNumber, characters, bombs, explosions, score, cellCount);
+}
+
+void HexabombRenderer::reset()
+{
+    completeBoardJobs();
+    _isSuddenDeath = false;
+
+    _cellColors.clear();
+    _cellDrawColors.clear();
+    _heatmaps.reset(0, 0);
+    _borderVertices.clear();
+    _boardTextureValid = false;
+    _paintedColors.clear();
+    for (auto & scene : _scenes)
+    {
+        scene.cellVertices.clear();
+        scene.spriteVertices.clear();
+    }
+    _sprites.clear();
+
+    _pInfoText.clear();
+    _pInfoShapes.clear();
+    _ccdShapes.clear();
+    for (auto & line : _chartLines)
+        line.clear();
+
+    _playersInfo.clear();
+    _pInfoOrder.clear();
+    _pInfoScores.clear();
+    _currentTurnNumber = 0;
+    _lastTurnNumber = 0;
+    _score.clear();
+    _cellCount.clear();
+    _stats.reset({});
+    _nbNeutralCells = 0;
+    _cellCountMismatchReported = false;
+    _invalidColorReported = false;
+
+    _coordinatesText.clear();
+    _bombs.clear();
+    _forecastVertices.clear();
+    _forecastDelays.clear();
+    _forecastCells.clear();
+    _forecastText.clear();
+
+    // The status of the previous game may be "game over", which is otherwise final.
+    _status.clear();
+    layoutStatus();
+}
+
+size_t HexabombRenderer::memoryUsage() const
+{
+    size_t bytes = _board.memoryUsage() + _heatmaps.memoryUsage() + _stats.memoryUsage();
+    bytes += (_cellColors.capacity() + _cellDrawColors.capacity() + _pInfoOrder.capacity() + _pInfoScores.capacity()) * sizeof(int);
+    bytes += _sprites.capacity() * sizeof(Sprite);
+    bytes += _playersInfo.capacity() * sizeof(netorcai::PlayerInfo);
+
+    bytes += _bombs.capacity() * sizeof(Bomb);
+    bytes += (_forecastDelays.capacity() + _forecastCells.capacity()) * sizeof(int);
+
+    bytes += _paintedColors.capacity() * sizeof(uint32_t);
+
+    size_t nbVertices = _borderVertices.getVertexCount() + _forecastVertices.getVertexCount() + _repaintVertices.getVertexCount()
+        + _pInfoShapes.getVertexCount() + _ccdShapes.getVertexCount();
+    for (const auto & line : _chartLines)
+        nbVertices += line.getVertexCount();
+    for (const auto & scene : _scenes)
+        nbVertices += scene.cellVertices.getVertexCount() + scene.spriteVertices.getVertexCount();
+    bytes += nbVertices * sizeof(sf::Vertex);
+
+    return bytes;
 }
 
 void HexabombRenderer::updatePlayerInfo(int currentTurnNumber,
@@ -285,114 +667,290 @@ void HexabombRenderer::updatePlayerInfo(int currentTurnNumber,
     else
         _playersInfo = playersInfo;
 
-    typedef std::tuple<int, int, int> ScorePidIndex;
-    std::vector<ScorePidIndex> pInfoTravarsalOrder;
-    for (int i = 0; i < _playersInfo.size(); i++)
+    if (_pInfoOrder.size() != _playersInfo.size())
     {
-        const auto & info = _playersInfo[i];
-        pInfoTravarsalOrder.push_back(std::make_tuple(_score[info.playerID], info.playerID, i));
+        _pInfoOrder.resize(_playersInfo.size());
+        std::iota(_pInfoOrder.begin(), _pInfoOrder.end(), 0);
     }
 
-    if (_isSuddenDeath)
+    _currentTurnNumber = currentTurnNumber;
+    _lastTurnNumber = lastTurnNumber;
+    layoutPlayerInfo();
+}
+
+void HexabombRenderer::sortPlayerInfo(bool byScore)
+{
+    _pInfoScores.resize(_playersInfo.size());
+    for (unsigned int i = 0; i < _playersInfo.size(); i++)
+    {
+        auto it = _score.find(_playersInfo[i].playerID);
+        _pInfoScores[i] = (it != _score.end()) ? it->second : 0;
+    }
+
+    // Decreasing (score, playerID, index) order if byScore, increasing index order otherwise.
+    auto isBefore = [&](int a, int b)
+    {
+        if (!byScore)
+            return a < b;
+        return std::make_tuple(_pInfoScores[a], _playersInfo[a].playerID, a) >
+               std::make_tuple(_pInfoScores[b], _playersInfo[b].playerID, b);
+    };
+
+    // Insertion sort from the previous turn order.
+    // Rankings change little from one turn to the next, so this is close to linear.
+    for (unsigned int i = 1; i < _pInfoOrder.size(); i++)
     {
-        // Sort traversal order by decreasing score.
-        std::sort(pInfoTravarsalOrder.begin(), pInfoTravarsalOrder.end(), std::greater<std::tuple<int,int,int>>());
+        const int index = _pInfoOrder[i];
+        unsigned int j = i;
+        for (; j > 0 && isBefore(index, _pInfoOrder[j-1]); j--)
+            _pInfoOrder[j] = _pInfoOrder[j-1];
+        _pInfoOrder[j] = index;
     }
+}
+
+static void appendRect(sf::VertexArray & vertices, float x, float y, float width, float height, sf::Color color)
+{
+    const sf::Vector2f topLeft(x, y);
+    const sf::Vector2f topRight(x + width, y);
+    const sf::Vector2f bottomLeft(x, y + height);
+    const sf::Vector2f bottomRight(x + width, y + height);
+
+    vertices.append(sf::Vertex(topLeft, color));
+    vertices.append(sf::Vertex(topRight, color));
+    vertices.append(sf::Vertex(bottomLeft, color));
+    vertices.append(sf::Vertex(bottomLeft, color));
+    vertices.append(sf::Vertex(topRight, color));
+    vertices.append(sf::Vertex(bottomRight, color));
+}
+
+static void appendSegment(sf::VertexArray & vertices, sf::Vector2f from, sf::Vector2f to, float thickness, sf::Color color)
+{
+    const sf::Vector2f direction = to - from;
+    const float length = sqrt(direction.x * direction.x + direction.y * direction.y);
+    if (length <= 0.f)
+        return;
+
+    const sf::Vector2f normal = sf::Vector2f(-direction.y, direction.x) * (thickness / (2.f * length));
+
+    vertices.append(sf::Vertex(from + normal, color));
+    vertices.append(sf::Vertex(to + normal, color));
+    vertices.append(sf::Vertex(from - normal, color));
+    vertices.append(sf::Vertex(from - normal, color));
+    vertices.append(sf::Vertex(to + normal, color));
+    vertices.append(sf::Vertex(to - normal, color));
+}
 
-    // Update rendering data
+template <bool isSuddenDeath>
+void HexabombRenderer::layoutPlayerInfo()
+{
     const float baseH = 70.f;
     float hPlayers = 100.f;
-    if (_isSuddenDeath)
+    if (isSuddenDeath)
         hPlayers = 75.f;
     const float hLines = 20.f;
     const float rectX = 2.f;
     const float textX = 4.f;
-    const float barThickness = 1.f;
+    const float outlineThickness = 2.f;
+    const float barThickness = 3.f;
+
+    // Players that do not fit in the panel are shown as a compact leaderboard.
+    const float playersHeight = _panelHeight - (_showChart ? _chartHeight : 0.f);
+    const int nbPlayers = _playersInfo.size();
+    const bool compact = baseH + hPlayers * nbPlayers > playersHeight;
 
-    sf::Text text = _statusText;
+    sortPlayerInfo(isSuddenDeath || compact);
+
+    _pInfoText.clear();
+    _pInfoShapes.clear();
+    if (compact)
+        _pInfoText.setCharacterSize(_piCompactCharacterSize);
+    else
+        _pInfoText.setCharacterSize(_piCharacterSize);
 
-    text.setPosition(textX, 0.f);
     char * turnCString = nullptr;
-    asprintf(&turnCString, "turn: %0*d/%d", (int)log10f(lastTurnNumber)+1, currentTurnNumber, lastTurnNumber);
-    text.setString(std::string(turnCString));
+    asprintf(&turnCString, "turn: %0*d/%d", (int)log10f(_lastTurnNumber)+1, _currentTurnNumber, _lastTurnNumber);
+    _pInfoText.append(turnCString, sf::Vector2f(textX, 0.f));
     free(turnCString);
-    _pInfoTexts.push_back(text);
 
-    _statusText.setPosition(textX, hLines);
+    _statusPosition = sf::Vector2f(textX, hLines);
+    layoutStatus();
+
+    if (_showOverlay)
+    {
+        _pInfoText.append(std::string("overlay: ") + Heatmaps::kindName(_overlayKind),
+            sf::Vector2f(textX, compact ? 36.f : 2*hLines));
+    }
 
-    for (int i = 0; i < pInfoTravarsalOrder.size(); i++)
+    if (!compact)
     {
-        const auto & scorePidIndex = pInfoTravarsalOrder[i];
-        const int originalI = std::get<2>(scorePidIndex);
-        const netorcai::PlayerInfo & info = _playersInfo[originalI];
-        int j = -1;
+        for (int i = 0; i < nbPlayers; i++)
+        {
+            const netorcai::PlayerInfo & info = _playersInfo[_pInfoOrder[i]];
+            const float y = baseH + hPlayers*i;
+            int j = -1;
 
-        sf::RectangleShape rect(sf::Vector2f(_piRectWidth, hPlayers));
-        rect.setFillColor(_colors[info.playerID+1]);
-        rect.setOutlineThickness(2.f);
-        rect.setOutlineColor(sf::Color::Black);
-        rect.setPosition(rectX, baseH + hPlayers*i);
-        _pInfoRectShapes.push_back(rect);
+            appendRect(_pInfoShapes, rectX - outlineThickness, y - outlineThickness,
+                _piRectWidth + 2*outlineThickness, hPlayers + 2*outlineThickness, sf::Color::Black);
+            appendRect(_pInfoShapes, rectX, y, _piRectWidth, hPlayers, _colors[info.playerID+1]);
 
-        j++;
-        text.setPosition(textX, baseH + hPlayers*i + hLines*j);
-        text.setString(info.nickname + " (" + std::to_string(info.playerID) + ")");
-        _pInfoTexts.push_back(text);
+            j++;
+            _pInfoText.append(info.nickname + " (" + std::to_string(info.playerID) + ")",
+                sf::Vector2f(textX, y + hLines*j));
 
-        j++;
-        text.setPosition(textX, baseH + hPlayers*i + hLines*j);
-        text.setString("  score: " + std::to_string(_score[info.playerID]));
-        _pInfoTexts.push_back(text);
+            j++;
+            _pInfoText.append("  score: " + std::to_string(_score[info.playerID]),
+                sf::Vector2f(textX, y + hLines*j));
+
+            if (!isSuddenDeath)
+            {
+                j++;
+                _pInfoText.append("  #cells: " + std::to_string(_cellCount[info.playerID]),
+                    sf::Vector2f(textX, y + hLines*j));
+            }
 
-        if (!_isSuddenDeath)
-        {
             j++;
-            text.setPosition(textX, baseH + hPlayers*i + hLines*j);
-            text.setString("  #cells: " + std::to_string(_cellCount[info.playerID]));
-            _pInfoTexts.push_back(text);
+            _pInfoText.append("  " + info.remoteAddress, sf::Vector2f(textX, y + hLines*j));
+
+            if (!info.isConnected)
+            {
+                appendSegment(_pInfoShapes, sf::Vector2f(rectX, y),
+                    sf::Vector2f(rectX + _piRectWidth, y + hPlayers), barThickness, sf::Color::Black);
+                appendSegment(_pInfoShapes, sf::Vector2f(rectX, y + hPlayers),
+                    sf::Vector2f(rectX + _piRectWidth, y), barThickness, sf::Color::Black);
+            }
+        }
+    }
+    else
+    {
+        // One line per player, as many as the panel height allows (top-K).
+        const float rowH = _piCompactRowHeight;
+        const int nbRowsFit = std::max(0, (int)((playersHeight - baseH) / rowH));
+        int nbRows = nbPlayers;
+        if (nbRows > nbRowsFit)
+            nbRows = std::max(0, nbRowsFit - 1);
+
+        char line[64];
+        if (isSuddenDeath)
+            snprintf(line, sizeof(line), "%3s %-10s %7s", "#", "player", "score");
+        else
+            snprintf(line, sizeof(line), "%3s %-10s %7s %6s", "#", "player", "score", "cells");
+        _pInfoText.append(line, sf::Vector2f(textX, baseH - rowH));
+
+        for (int i = 0; i < nbRows; i++)
+        {
+            const netorcai::PlayerInfo & info = _playersInfo[_pInfoOrder[i]];
+            const float y = baseH + rowH*i;
+
+            appendRect(_pInfoShapes, rectX, y, _piRectWidth, rowH - 1.f, _colors[info.playerID+1]);
+
+            if (isSuddenDeath)
+                snprintf(line, sizeof(line), "%3d %-10.10s %7d",
+                    i+1, info.nickname.c_str(), _pInfoScores[_pInfoOrder[i]]);
+            else
+                snprintf(line, sizeof(line), "%3d %-10.10s %7d %6d",
+                    i+1, info.nickname.c_str(), _pInfoScores[_pInfoOrder[i]], _cellCount[info.playerID]);
+            _pInfoText.append(line, sf::Vector2f(textX, y));
+
+            if (!info.isConnected)
+            {
+                appendSegment(_pInfoShapes, sf::Vector2f(rectX, y + rowH/2.f),
+                    sf::Vector2f(rectX + _piRectWidth, y + rowH/2.f), 1.f, sf::Color::Black);
+            }
+        }
+
+        if (nbRows < nbPlayers)
+        {
+            snprintf(line, sizeof(line), "    +%d more", nbPlayers - nbRows);
+            _pInfoText.append(line, sf::Vector2f(textX, baseH + rowH*nbRows));
         }
+    }
+
+    layoutChart();
+}
+
+void HexabombRenderer::layoutPlayerInfo()
+{
+    if (_isSuddenDeath)
+        layoutPlayerInfo<true>();
+    else
+        layoutPlayerInfo<false>();
+}
 
-        j++;
-        text.setPosition(textX, baseH + hPlayers*i + hLines*j);
-        text.setString("  " + info.remoteAddress);
-        _pInfoTexts.push_back(text);
+void HexabombRenderer::layoutChart()
+{
+    for (auto & line : _chartLines)
+        line.clear();
+
+    if (!_showChart)
+        return;
+
+    const float top = _panelHeight - _chartHeight;
+    const float left = 4.f;
+    const float width = _piRectWidth - 8.f;
+    const float plotTop = top + 24.f;
+    const float plotHeight = _chartHeight - 28.f;
+
+    appendRect(_pInfoShapes, left - 2.f, plotTop - 2.f, width + 4.f, plotHeight + 4.f, sf::Color::Black);
+    appendRect(_pInfoShapes, left, plotTop, width, plotHeight, sf::Color(0x303030ff));
+
+    const int maxValue = std::max(1, _stats.maxValue(_chartSeries));
+    _pInfoText.append(std::string(StatsStore::seriesName(_chartSeries)) + " (max " + std::to_string(maxValue) + ")",
+        sf::Vector2f(left, top));
+
+    const int nbRows = _stats.nbRows();
+    const auto & turns = _stats.turns();
+    const auto & playerIDs = _stats.playerIDs();
+    if (nbRows == 0)
+        return;
+
+    // At most one point per pixel column, whatever the number of stored turns.
+    const int nbPoints = std::min(nbRows, std::max(2, (int)width));
+    const float firstTurn = turns.front();
+    const float turnSpan = std::max(1, turns.back() - turns.front());
+
+    _chartLines.resize(playerIDs.size(), sf::VertexArray(sf::LineStrip));
+    for (unsigned int p = 0; p < playerIDs.size(); p++)
+    {
+        const auto & values = _stats.column(_chartSeries, p);
+        const sf::Color color = _colors[playerIDs[p]+1];
+        auto & line = _chartLines[p];
 
-        if (!info.isConnected)
+        for (int k = 0; k < nbPoints; k++)
         {
-            const float diagonalLength = sqrt(_piRectWidth*_piRectWidth+hPlayers*hPlayers);
-            rect.setFillColor(sf::Color::Black);
-            rect.setOutlineThickness(1.f);
-
-            rect.setSize(sf::Vector2f(diagonalLength, barThickness));
-            rect.setPosition(rectX, baseH + hPlayers*i);
-            rect.setOrigin(diagonalLength/2, barThickness/2);
-            rect.setRotation(acos(_piRectWidth/diagonalLength) * 180.f/M_PI);
-            rect.setOrigin(0.f, 0.f);
-            _pInfoRectShapes.push_back(rect);
-
-            rect.setPosition(rectX, baseH + hPlayers*(i+1));
-            rect.setOrigin(diagonalLength/2, barThickness/2);
-            rect.setRotation(-acos(_piRectWidth/diagonalLength) * 180.f/M_PI);
-            rect.setOrigin(0.f, 0.f);
-            _pInfoRectShapes.push_back(rect);
+            const int row = (nbPoints == 1) ? 0 : (int)((long)k * (nbRows - 1) / (nbPoints - 1));
+            const float x = left + width * (turns[row] - firstTurn) / turnSpan;
+            const float y = plotTop + plotHeight * (1.f - (float)values[row] / maxValue);
+            line.append(sf::Vertex(sf::Vector2f(x, y), color));
         }
     }
 }
 
-void HexabombRenderer::updateCellCount(const std::map<int, int> & cellCount)
+void HexabombRenderer::updateCellCount()
 {
-    _cellCount = cellCount;
+    _ccdShapes.clear();
+
+    // The counts sent by netorcai are displayed. They should match the board colors.
+    if (!_cellCountMismatchReported)
+    {
+        for (const auto & [playerID, nbPlayerCells] : _cellCount)
+        {
+            const int color = playerID + 1;
+            const int nbBoardCells = (color < (int)_colorHistogram.size()) ? _colorHistogram[color] : 0;
+            if (nbBoardCells != nbPlayerCells)
+            {
+                printf("Cell count mismatch for player %d: %d cells received, %d on the board\n",
+                    playerID, nbPlayerCells, nbBoardCells);
+                fflush(stdout);
+                _cellCountMismatchReported = true;
+            }
+        }
+    }
 
-    const float nbCells = _cellShapes.size();
+    const float nbCells = _board.size();
 
-    sf::RectangleShape rect;
     float width = _ccdWidth * _nbNeutralCells / nbCells;
     float offX = 0.f;
-
-    rect.setSize(sf::Vector2f(width, _ccdHeight));
-    rect.setFillColor(_colors[0]);
-    rect.setPosition(offX, 0.f);
-    _ccdRectShapes.push_back(rect);
+    appendRect(_ccdShapes, offX, 0.f, width, _ccdHeight, _colors[0]);
 
     for (const auto & it : _cellCount)
     {
@@ -401,119 +959,284 @@ void HexabombRenderer::updateCellCount(const std::map<int, int> & cellCount)
 
         offX += width;
         width = _ccdWidth * nbPlayerCells / nbCells;
-        rect.setSize(sf::Vector2f(width, _ccdHeight));
-        rect.setFillColor(_colors[playerID + 1]);
-        rect.setPosition(offX, 0.f);
-        _ccdRectShapes.push_back(rect);
+        appendRect(_ccdShapes, offX, 0.f, width, _ccdHeight, _colors[playerID + 1]);
     }
 }
 
-void HexabombRenderer::onStatusChange(const std::string & status)
+void HexabombRenderer::updateForecast()
 {
-    if (_status != "game over")
+    // Only the cells of the previous forecast are cleared, not the whole board.
+    for (int index : _forecastCells)
     {
-        _status = status;
-        _statusText.setString(_status);
+        setHexColor(_forecastVertices, index, sf::Color::Transparent);
+        _forecastDelays[index] = INT_MAX;
     }
-}
+    _forecastCells.clear();
+    _forecastText.clear();
 
-void HexabombRenderer::render(sf::RenderWindow & window)
-{
-    // Clear the window
-    window.clear(_backgroundColor);
+    if (!_showForecast)
+        return;
 
-    // Set view and viewport. Should not be done at each frame
-    window.setView(_boardView);
-
-    // Draw cells borders. Copy is delibarate here.
-    for (const auto & [coord, _] : _cellShapes)
+    // A cell is colored by the first bomb that reaches it. Sooner explosions are more opaque.
+    const sf::Glyph glyph = _assets.monospaceFont.getGlyph('0', _forecastText.getCharacterSize(), false);
+    for (const auto & bomb : _bombs)
     {
-        sf::CircleShape blackHex(128.f + 16.f, 6);
-        sf::Vector2f cartesian = axialToCartesian(coord);
-        blackHex.setPosition(cartesian);
-
-        sf::Vector2f center;
-        for (size_t i = 0; i < blackHex.getPointCount(); i++)
-            center += blackHex.getPoint(i);
-        center = center / (float)blackHex.getPointCount();
+        const int bombIndex = _board.indexOf(bomb.coord);
+        if (bombIndex < 0 || bomb.color < 0 || bomb.color >= (int)_colors.size())
+            continue;
 
-        blackHex.setOrigin(center);
-        blackHex.setFillColor(sf::Color::Black);
+        sf::Color color = _colors[bomb.color];
+        color.a = (sf::Uint8)(192 / std::max(1, bomb.delay));
+        auto reach = [&](int index)
+        {
+            if (bomb.delay >= _forecastDelays[index])
+                return;
+            if (_forecastDelays[index] == INT_MAX)
+                _forecastCells.push_back(index);
+            _forecastDelays[index] = bomb.delay;
+            setHexColor(_forecastVertices, index, color);
+        };
+
+        // The explosion goes up to range cells in each direction, and stops at holes.
+        reach(bombIndex);
+        for (int direction = 0; direction < BoardIndex::NB_DIRECTIONS; direction++)
+        {
+            int index = bombIndex;
+            for (int step = 0; step < bomb.range; step++)
+            {
+                index = _board.neighbor(index, direction);
+                if (index < 0)
+                    break;
+                reach(index);
+            }
+        }
 
-        window.draw(blackHex);
+        // The countdown is written above the bomb sprite.
+        const std::string countdown = std::to_string(bomb.delay);
+        const sf::Vector2f center = axialToCartesian(bomb.coord);
+        _forecastText.append(countdown, sf::Vector2f(center.x - countdown.size() * glyph.advance / 2.f,
+            center.y - _hexBaseLength), sf::Color::Black);
     }
+}
 
-    // Draw cells
-    for (const auto & [coord, shape] : _cellShapes)
-    {
-        window.draw(*shape);
+void HexabombRenderer::layoutStatus()
+{
+    _statusText.clear();
+    _statusText.append(_status, _statusPosition);
+}
 
-        const int charSize = 64;
-        const sf::Glyph glyph = _monospaceFont.getGlyph('0', charSize, false);
+void HexabombRenderer::layoutCoordinates()
+{
+    if (!_coordinatesText.empty())
+        return;
 
-        if (_showCoordinates)
-        {
-            sf::Text text;
-            text.setFont(_monospaceFont);
-            text.setCharacterSize(charSize);
-            text.setFillColor(sf::Color::Black);
-            text.setString("(" + std::to_string(coord.q) + "," + std::to_string(coord.r) + ")");
-            text.setOrigin(1.1f*(text.getString().getSize() * glyph.bounds.width / 2.f), 1.1f*(glyph.bounds.height/2.f));
-
-            sf::Vector2f cartesian = axialToCartesian(coord);
-            text.setPosition(cartesian);
-            window.draw(text);
-        }
+    // Each text is centered on its cell.
+    const sf::Glyph glyph = _assets.monospaceFont.getGlyph('0', _coordinatesText.getCharacterSize(), false);
+    for (int index = 0; index < _board.size(); index++)
+    {
+        const Coordinates & coord = _board.coordinates(index);
+        const std::string str = "(" + std::to_string(coord.q) + "," + std::to_string(coord.r) + ")";
+        const sf::Vector2f origin(1.1f*(str.size() * glyph.bounds.width / 2.f), 1.1f*(glyph.bounds.height/2.f));
+        _coordinatesText.append(str, axialToCartesian(coord) - origin);
     }
+}
 
-    // Draw characters
-    for (const auto & sprite : _charactersToDraw)
+void HexabombRenderer::onStatusChange(const std::string & status)
+{
+    if (_status != "game over")
     {
-        window.draw(*sprite);
+        _status = status;
+        layoutStatus();
     }
+}
+
+void HexabombRenderer::render(sf::RenderWindow & window)
+{
+    window.clear(_backgroundColor);
+    draw(window);
+
+    // Finally update the screen
+    window.display();
+}
 
-    // Draw bombs
-    for (const auto & sprite : _bombSprites)
+void HexabombRenderer::draw(sf::RenderTarget & window)
+{
+    // Clear the rendering area
+    window.setView(_areaView);
+    sf::RectangleShape background(sf::Vector2f(1.f, 1.f));
+    background.setFillColor(_backgroundColor);
+    window.draw(background);
+
+    // Draw cells borders, then cells, from the board texture if possible.
+    // The texture is mapped pixel for pixel on the board viewport.
+    pollBoardJobs();
+    const BoardScene & scene = _scenes[_frontScene];
+    if (updateBoardTexture(window))
+    {
+        const sf::Vector2u size = _boardTexture.getSize();
+        sf::View pixelView(sf::FloatRect(0.f, 0.f, size.x, size.y));
+        pixelView.setViewport(_boardView.getViewport());
+        window.setView(pixelView);
+        window.draw(sf::Sprite(_boardTexture.getTexture()));
+        window.setView(_boardView);
+    }
+    else
     {
-        window.draw(*sprite);
+        window.setView(_boardView);
+        window.draw(_borderVertices);
+        window.draw(scene.cellVertices);
     }
 
-    // Draw explosions
-    for (const auto & sprite : _explosionSprites)
+    if (_showForecast)
+        window.draw(_forecastVertices);
+
+    if (_showCoordinates)
     {
-        window.draw(*sprite);
+        layoutCoordinates();
+        window.draw(_coordinatesText);
     }
 
+    // Draw characters, bombs and explosions
+    window.draw(scene.spriteVertices, &atlas().texture());
+    if (_showForecast)
+        window.draw(_forecastText);
+
     // Draw player informations
     window.setView(_playersInfoView);
     window.draw(_statusText);
-    for (const auto & shape : _pInfoRectShapes)
+    window.draw(_pInfoShapes);
+    window.draw(_pInfoText);
+    for (const auto & line : _chartLines)
+        window.draw(line);
+
+    // Draw cell count distribution
+    window.setView(_cellCountDistributionView);
+    window.draw(_ccdShapes);
+}
+
+bool HexabombRenderer::updateBoardTexture(const sf::RenderTarget & target)
+{
+    if (_boardTextureUnavailable)
+        return false;
+
+    // Recreated on resize only: Its pixels are the pixels of the board viewport.
+    const sf::IntRect viewport = target.getViewport(_boardView);
+    const sf::Vector2u size(std::max(1, viewport.width), std::max(1, viewport.height));
+    if (_boardTexture.getSize() != size)
     {
-        window.draw(shape);
+        if (!_boardTexture.create(size.x, size.y))
+        {
+            printf("Cannot create the board texture: The board is drawn at each frame\n"); fflush(stdout);
+            _boardTextureUnavailable = true;
+            return false;
+        }
+        _boardTextureValid = false;
     }
 
-    for (const auto & text : _pInfoTexts)
+    if (_boardTextureValid && _paintedSerial == _sceneSerial)
+        return true;
+
+    sf::View view = _boardView;
+    view.setViewport(sf::FloatRect(0.f, 0.f, 1.f, 1.f));
+    _boardTexture.setView(view);
+
+    // Cells do not overlap their borders nor each other, and their colors are opaque:
+    // A cell is repainted by drawing its hexagon again.
+    const BoardScene & scene = _scenes[_frontScene];
+    const int nbCells = _board.size();
+    if (!_boardTextureValid)
     {
-        window.draw(text);
+        _boardTexture.clear(_backgroundColor);
+        _boardTexture.draw(_borderVertices);
+        _boardTexture.draw(scene.cellVertices);
+        _paintedColors.resize(nbCells);
+        for (int index = 0; index < nbCells; index++)
+            _paintedColors[index] = packColor(scene.cellVertices[index * _verticesPerHex].color);
     }
+    else
+    {
+        _repaintVertices.clear();
+        for (int index = 0; index < nbCells; index++)
+        {
+            const uint32_t color = packColor(scene.cellVertices[index * _verticesPerHex].color);
+            if (color == _paintedColors[index])
+                continue;
 
-    // Draw cell count distribution
-    window.setView(_cellCountDistributionView);
-    for (const auto & shape : _ccdRectShapes)
+            _paintedColors[index] = color;
+            for (int i = 0; i < _verticesPerHex; i++)
+                _repaintVertices.append(scene.cellVertices[index * _verticesPerHex + i]);
+        }
+
+        if (_repaintVertices.getVertexCount() == 0)
+        {
+            _paintedSerial = _sceneSerial;
+            return true;
+        }
+        _boardTexture.draw(_repaintVertices);
+    }
+
+    _boardTexture.display();
+    _boardTextureValid = true;
+    _paintedSerial = _sceneSerial;
+    return true;
+}
+
+void HexabombRenderer::draw(SoftwareCanvas & canvas)
+{
+    canvas.setView(_areaView);
+    canvas.fillViewport(_backgroundColor);
+
+    // Cells and borders are filled as hexagons, which is much faster than as triangles.
+    // Canvas draws wait for the thread pool anyway: The latest turn is always drawn, as exported frames need.
+    canvas.setView(_boardView);
+    canvas.drawHexes(_borderVertices, _verticesPerHex);
+    completeBoardJobs();
+    const BoardScene & scene = _scenes[_frontScene];
+    canvas.drawHexes(scene.cellVertices, _verticesPerHex);
+    if (_showForecast)
+        canvas.drawHexes(_forecastVertices, _verticesPerHex);
+
+    if (_showCoordinates)
     {
-        window.draw(shape);
+        layoutCoordinates();
+        canvas.draw(_coordinatesText);
     }
 
-    // Finally update the screen
-    window.display();
+    if (atlas().isReady())
+        canvas.draw(scene.spriteVertices, &atlas().image());
+    if (_showForecast)
+        canvas.draw(_forecastText);
+
+    canvas.setView(_playersInfoView);
+    canvas.draw(_statusText);
+    canvas.draw(_pInfoShapes);
+    canvas.draw(_pInfoText);
+    for (const auto & line : _chartLines)
+        canvas.draw(line);
+
+    canvas.setView(_cellCountDistributionView);
+    canvas.draw(_ccdShapes);
 }
 
-void HexabombRenderer::updateView(int newWidth, int newHeight)
+void HexabombRenderer::updateView(int newWidth, int newHeight, sf::FloatRect area)
 {
+    // Maps a rectangle relative to the rendering area to window viewport coordinates.
+    auto inArea = [&area](const sf::FloatRect & rect)
+    {
+        return sf::FloatRect(area.left + rect.left * area.width, area.top + rect.top * area.height,
+            rect.width * area.width, rect.height * area.height);
+    };
+
+    const float areaWidth = newWidth * area.width;
+    const float areaHeight = newHeight * area.height;
+
+    _areaView.reset(sf::FloatRect(0.f, 0.f, 1.f, 1.f));
+    _areaView.setViewport(area);
+
     // Keep aspect ratio with a resizable window.
     // https://en.sfml-dev.org/forums/index.php?topic=15802.msg113936#msg113936
-    float screenWidth = newWidth - _piRectWidth;
-    float screenHeight = newHeight * (1-_ccdHeightRatioInScreen);
+    float screenWidth = std::max(1.f, areaWidth - _piRectWidth);
+    float screenHeight = std::max(1.f, areaHeight * (1-_ccdHeightRatioInScreen));
 
     sf::FloatRect viewport;
     viewport.width = 1.f;
@@ -530,17 +1253,30 @@ void HexabombRenderer::updateView(int newWidth, int newHeight)
         viewport.top = (1.f - viewport.height) / 2.f;
     }
 
-    viewport.width *= (1-(_piRectWidth/newWidth));
-    viewport.height *= (1-_ccdHeightRatioInScreen);
-    _boardView.setViewport(viewport);
+    // The board is the area minus the players information panel and the cell count distribution.
+    const float boardWidthRatio = screenWidth / areaWidth;
+    const float boardHeightRatio = 1-_ccdHeightRatioInScreen;
+    viewport.left *= boardWidthRatio;
+    viewport.width *= boardWidthRatio;
+    viewport.top *= boardHeightRatio;
+    viewport.height *= boardHeightRatio;
+    _boardView.setViewport(inArea(viewport));
+    _boardTextureValid = false;
+    _boardViewportSize = sf::Vector2f(viewport.width * areaWidth, viewport.height * areaHeight);
+    updateAtlas();
 
     // Players misc. information.
-    _playersInfoView.reset(sf::FloatRect(0.f, 0.f, newWidth, newHeight));
-    _playersInfoView.setViewport(sf::FloatRect(1-(_piRectWidth/newWidth), 0.f, 1.f, 1.f));
+    _playersInfoView.reset(sf::FloatRect(0.f, 0.f, _piRectWidth, areaHeight));
+    _playersInfoView.setViewport(inArea(sf::FloatRect(boardWidthRatio, 0.f, 1.f - boardWidthRatio, 1.f)));
 
     // Cell count distribution
     _cellCountDistributionView.reset(sf::FloatRect(0.f, 0.f, _ccdWidth, _ccdHeight));
-    _cellCountDistributionView.setViewport(sf::FloatRect(0.f, 1-_ccdHeightRatioInScreen, 1.f, 1.f));
+    _cellCountDistributionView.setViewport(inArea(sf::FloatRect(0.f, boardHeightRatio, 1.f, 1.f - boardHeightRatio)));
+
+    // The number of players that fit in the panel depends on its height.
+    _panelHeight = areaHeight;
+    if (!_playersInfo.empty())
+        layoutPlayerInfo();
 }
 
 void HexabombRenderer::toggleShowCoordinates()
@@ -548,11 +1284,104 @@ void HexabombRenderer::toggleShowCoordinates()
     _showCoordinates = !_showCoordinates;
 }
 
+void HexabombRenderer::cycleOverlay()
+{
+    if (!_showOverlay)
+    {
+        _showOverlay = true;
+        _overlayKind = Heatmaps::OWNER_CHANGES;
+    }
+    else if (_overlayKind + 1 < Heatmaps::NB_KINDS)
+        _overlayKind = (Heatmaps::Kind)(_overlayKind + 1);
+    else
+        _showOverlay = false;
+
+    recolorBoard();
+    if (!_playersInfo.empty())
+        layoutPlayerInfo();
+}
+
+void HexabombRenderer::toggleBombForecast()
+{
+    _showForecast = !_showForecast;
+    updateForecast();
+}
+
+void HexabombRenderer::cycleChart()
+{
+    if (!_showChart)
+    {
+        _showChart = true;
+        _chartSeries = StatsStore::SCORE;
+    }
+    else if (_chartSeries == StatsStore::SCORE)
+        _chartSeries = StatsStore::CELL_COUNT;
+    else
+        _showChart = false;
+
+    if (!_playersInfo.empty())
+        layoutPlayerInfo();
+}
+
+const StatsStore & HexabombRenderer::stats() const
+{
+    return _stats;
+}
+
+void HexabombRenderer::setThreadPool(ThreadPool * threadPool)
+{
+    _threadPool = threadPool;
+}
+
+void HexabombRenderer::setSharedAtlas(const SpriteAtlas * atlas)
+{
+    completeBoardJobs();
+    _sharedAtlas = atlas;
+    layoutSprites();
+}
+
 void HexabombRenderer::setSuddenDeath(bool isSuddenDeath)
 {
     _isSuddenDeath = isSuddenDeath;
 }
 
+/**
+ * @brief Convert an OKLCh color to sRGB
+ * @param l The perceived lightness, in [0,1]
+ * @param c The chroma
+ * @param h The hue in radians
+ * @return The sRGB color, clamped to the sRGB gamut
+ */
+static sf::Color oklchToColor(float l, float c, float h)
+{
+    // https://bottosson.github.io/posts/oklab/
+    const float a = c * cosf(h);
+    const float b = c * sinf(h);
+
+    float l_ = l + 0.3963377774f * a + 0.2158037573f * b;
+    float m_ = l - 0.1055613458f * a - 0.0638541728f * b;
+    float s_ = l - 0.0894841775f * a - 1.2914855480f * b;
+    l_ = l_ * l_ * l_;
+    m_ = m_ * m_ * m_;
+    s_ = s_ * s_ * s_;
+
+    const float linear[3] = {
+        +4.0767416621f * l_ - 3.3077115913f * m_ + 0.2309699292f * s_,
+        -1.2684380046f * l_ + 2.6097574011f * m_ - 0.3413193965f * s_,
+        -0.0041960863f * l_ - 0.7034186147f * m_ + 1.7076147010f * s_
+    };
+
+    sf::Uint8 srgb[3];
+    for (int i = 0; i < 3; i++)
+    {
+        const float x = std::min(1.f, std::max(0.f, linear[i]));
+        const float gamma = (x <= 0.0031308f) ? 12.92f * x : 1.055f * powf(x, 1.f/2.4f) - 0.055f;
+        srgb[i] = (sf::Uint8)std::lround(255.f * gamma);
+    }
+
+    return sf::Color(srgb[0], srgb[1], srgb[2]);
+}
+
 void HexabombRenderer::generatePlayerColors(int nbColors)
 {
     // Viridis color palette. Generated in R: viridis_pal(begin=0.2, direction=-1)(6)
@@ -574,9 +1403,24 @@ void HexabombRenderer::generatePlayerColors(int nbColors)
     if (_isSuddenDeath)
         _colors.push_back(sf::Color::White); // Special player
 
-    while ((int)_colors.size() < nbColors + 1)
+    const int nbPlayerColors = nbColors + 1 - (int)_colors.size();
+    if (nbPlayerColors <= 6)
     {
         for (int i = 0; i < 6; i++)
             _colors.push_back(viridis[traversal_order[i]]);
     }
+    else
+    {
+        // Too many players for viridis to stay distinguishable: Spread hues by the golden angle
+        // in the perceptually uniform OKLCh space, cycling over three lightness levels.
+        const float lightness[3] = {0.75f, 0.55f, 0.87f};
+        const float chroma = 0.13f;
+        const float goldenAngle = 137.50776f * M_PI / 180.f;
+
+        for (int i = 0; i < nbPlayerColors; i++)
+        {
+            const float hue = 1.f + goldenAngle * i;
+            _colors.push_back(oklchToColor(lightness[i % 3], chroma, hue));
+        }
+    }
 }
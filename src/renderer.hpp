@@ -6,13 +6,21 @@
 
 #include <SFML/Graphics.hpp>
 
+#include "assets.hpp"
+#include "board-index.hpp"
+#include "heatmaps.hpp"
 #include "hexabomb-parse.hpp"
+#include "software-canvas.hpp"
+#include "sprite-atlas.hpp"
+#include "stats.hpp"
+#include "text-batch.hpp"
+#include "thread-pool.hpp"
+#include "turn-digest.hpp"
 
 class HexabombRenderer
 {
 public:
-    HexabombRenderer();
-    ~HexabombRenderer();
+    explicit HexabombRenderer(const Assets & assets);
 
     void onGameInit(
         const std::unordered_map<Coordinates, Cell> & cells,
@@ -23,6 +31,14 @@ public:
         int lastTurnNumber,
         const std::vector<netorcai::PlayerInfo> & playersInfo);
 
+    /**
+     * @brief Apply a turn
+     * @details Only the cell and sprite vertices are built in the background, in the back scene, by the
+     *          thread pool if any. They show up once done (see isUpdating). Everything else runs on the
+     *          calling thread before returning, between two frames: Waiting for the jobs of the previous
+     *          turn, the cell and character updates, heatmaps, statistics and the panel layout.
+     *          Without a thread pool, the vertices are built there as well.
+     */
     void onTurn(
         const std::unordered_map<Coordinates, Cell> & cells,
         const std::vector<Character> & characters,
@@ -34,56 +50,224 @@ public:
         int lastTurnNumber,
         const std::vector<netorcai::PlayerInfo> & playersInfo = {});
 
+    /// Record a turn that is not displayed, so that statistics and heatmaps still cover it.
+    void onSkippedTurn(const TurnDigest & digest);
+
+    /// Record a turn that is not displayed, from its whole state (same parameters as onTurn).
+    void onSkippedTurn(
+        const std::unordered_map<Coordinates, Cell> & cells,
+        const std::vector<Character> & characters,
+        const std::vector<Bomb> & bombs,
+        const std::unordered_map<int, std::vector<Coordinates> > & explosions,
+        const std::map<int, int> & score,
+        const std::map<int, int> & cellCount,
+        int currentTurnNumber);
+
     void onStatusChange(const std::string & status);
 
+    /**
+     * @brief Forget the current game, so that the next one can be initialized
+     * @details Buffers are cleared but keep their memory, so that successive games
+     *          reuse the same storage. Views and sprite atlas are kept as well.
+     *          Sudden death is unset: Call setSuddenDeath after this if needed.
+     */
+    void reset();
+
+    /// The approximate heap memory held by the game buffers, in bytes.
+    size_t memoryUsage() const;
+
+    /// Whether a turn is still being built in the background. It shows up in a later frame.
+    bool isUpdating() const { return _boardJobsPending; }
+
     void render(sf::RenderWindow & window);
-    void updateView(int newWidth, int newHeight);
+    void draw(sf::RenderTarget & target);
+
+    /**
+     * @brief Draw the same layers as draw(sf::RenderTarget &), on the CPU
+     * @details For machines without GPU. Views are the same as for a window of the canvas size.
+     */
+    void draw(SoftwareCanvas & canvas);
+
+    /**
+     * @brief Update the views after a resize
+     * @param newWidth The window width, in pixels
+     * @param newHeight The window height, in pixels
+     * @param area The window area to render into, in viewport coordinates (the whole window by default)
+     */
+    void updateView(int newWidth, int newHeight, sf::FloatRect area = sf::FloatRect(0.f, 0.f, 1.f, 1.f));
     void toggleShowCoordinates();
+    void cycleChart(); //!< Cycle the statistics chart between score, cell count and hidden.
+    void cycleOverlay(); //!< Cycle the board between the heatmap overlays and the cell colors.
+    void toggleBombForecast(); //!< Show or hide the cells that pending bombs will color, and their countdown.
     void setSuddenDeath(bool isSuddenDeath);
 
+    /**
+     * @brief Share a pool of worker threads to update large boards
+     * @details The pool must outlive the renderer. Renderers sharing a pool must be updated from the same thread.
+     */
+    void setThreadPool(ThreadPool * threadPool);
+
+    /**
+     * @brief Draw sprites from an atlas rasterized beforehand, instead of one rasterized for each view size
+     * @details For renderers that share one atlas: It is only read. The atlas must outlive the renderer,
+     *          and have a texture if the renderer draws to windows. nullptr goes back to the renderer's own atlas.
+     */
+    void setSharedAtlas(const SpriteAtlas * atlas);
+
+    const StatsStore & stats() const;
+
+    /// The character sizes of all texts the renderer lays out (see Assets::freezeFont).
+    static std::vector<unsigned int> characterSizes();
+
 private:
+    /// The board layers that change every turn.
+    struct BoardScene
+    {
+        sf::VertexArray cellVertices = sf::VertexArray(sf::Triangles); //!< One hexagon per cell, in BoardIndex order.
+        sf::VertexArray spriteVertices = sf::VertexArray(sf::Triangles); //!< One textured quad per sprite.
+    };
+
+    /// Recoloring of a range of cells, and the histogram of their colors.
+    struct RecolorJob
+    {
+        BoardScene * scene = nullptr;
+        int begin = 0;
+        int end = 0;
+        std::vector<int> histogram;
+        std::vector<int> scratch;
+    };
+
     void generatePlayerColors(int nbColors);
     void updatePlayerInfo(
         int currentTurnNumber,
         int lastTurnNumber,
         const std::vector<netorcai::PlayerInfo> & playersInfo);
-    void updateCellCount(const std::map<int, int> & cellCount);
+    void sortPlayerInfo(bool byScore);
+    void layoutPlayerInfo();
+    template <bool isSuddenDeath> void layoutPlayerInfo();
+    void layoutChart();
+    void layoutStatus();
+    void layoutCoordinates(); //!< Lay out the cell coordinates, if they are not already.
+    void updateForecast();
+    void updateCellCount();
+    void recordSkippedCell(const Coordinates & coord, int color);
+    void recordSkippedTurn(
+        const std::vector<Character> & characters,
+        const std::vector<Bomb> & bombs,
+        const std::unordered_map<int, std::vector<Coordinates> > & explosions,
+        const std::map<int, int> & score,
+        const std::map<int, int> & cellCount,
+        int currentTurnNumber);
+    bool checkColor(int color); //!< Whether a received color is in the palette. Invalid colors are reported once per game.
     sf::Vector2f axialToCartesian(Coordinates axial) const;
+    void setHexGeometry(sf::VertexArray & vertices, int index, sf::Vector2f center, float radius) const;
+    void setHexColor(sf::VertexArray & vertices, int index, sf::Color color);
+    sf::Color heatmapColor(int index) const;
+    void recolorBoard();
+    void recolorCellRange(RecolorJob & job);
+    template <bool isSuddenDeath> void updateCells(const std::unordered_map<Coordinates, Cell> & cells);
+    template <bool isSuddenDeath> void updateCharacters(const std::vector<Character> & characters);
+    void appendSprite(sf::Vector2f position, Assets::ImageID image);
+    void layoutSprites();
+    void layoutSprites(sf::VertexArray & vertices, int begin, int end);
+    void startBoardJobs(BoardScene & scene, bool withSprites);
+    void completeBoardJobs(); //!< Wait for the board jobs, if any, then finish them.
+    void pollBoardJobs(); //!< Finish the board jobs if they are done, without waiting.
+    void finishBoardJobs();
+    void updateAtlas();
+    const SpriteAtlas & atlas() const { return _sharedAtlas != nullptr ? *_sharedAtlas : _atlas; }
+    bool updateBoardTexture(const sf::RenderTarget & target); //!< Repaint the changed cells. False if there is no texture.
 
 private:
     bool _showCoordinates = false;
-    bool _isSuddenDeath = false;
-
-    sf::Texture _bombTexture;
-    sf::Texture _characterTexture;
-    sf::Texture _deadCharacterTexture;
-    sf::Texture _specialCharacterTexture;
-    sf::Texture _explosionTexture;
-
-    sf::Font _monospaceFont;
-
-    std::unordered_map<Coordinates, sf::CircleShape*> _cellShapes;
-    std::unordered_map<int, sf::Sprite*> _characterSprites;
-    std::vector<sf::Sprite*> _charactersToDraw;
-    std::vector<sf::Sprite*> _bombSprites;
-    std::vector<sf::Sprite*> _explosionSprites;
-    std::vector<sf::Text> _pInfoTexts;
-    std::vector<sf::RectangleShape> _pInfoRectShapes;
-    std::vector<sf::RectangleShape> _ccdRectShapes;
-    sf::Text _statusText;
+    bool _showChart = false;
+    StatsStore::Series _chartSeries = StatsStore::SCORE;
+    bool _showOverlay = false;
+    Heatmaps::Kind _overlayKind = Heatmaps::OWNER_CHANGES;
+    bool _isSuddenDeath = false; //!< Fixed for a whole game. Per-turn code is specialized on it (template parameter).
+
+    const Assets & _assets;
+    ThreadPool * _threadPool = nullptr;
+    std::vector<RecolorJob> _recolorJobs;
+    std::vector<std::function<void()> > _jobs; //!< The jobs running on the thread pool, if any.
+    bool _boardJobsPending = false; //!< Whether board jobs have been started and not finished yet.
+
+    // Turns are built in the back scene while the front scene is drawn, then the scenes are swapped.
+    // Only the renderer thread swaps and draws, between two frames, so the swap is a plain index change.
+    BoardScene _scenes[2];
+    int _frontScene = 0;
+    bool _swapScenesWhenDone = false;
+    uint64_t _sceneSerial = 0; //!< Incremented each time the cell colors of the front scene change.
+
+    // Windows draw borders and cells from a texture at the resolution of the board viewport.
+    // Only the cells whose color changed since the texture was painted are drawn into it again.
+    sf::RenderTexture _boardTexture;
+    bool _boardTextureValid = false; //!< Whether _boardTexture holds the whole board for the current view.
+    bool _boardTextureUnavailable = false; //!< Set if render textures are not supported: The board is then drawn directly.
+    uint64_t _paintedSerial = 0; //!< The _sceneSerial _boardTexture was last painted at.
+    std::vector<uint32_t> _paintedColors; //!< The color of each cell in _boardTexture (see packColor).
+    sf::VertexArray _repaintVertices = sf::VertexArray(sf::Triangles); //!< The cells to paint again.
+
+    BoardIndex _board;
+    std::vector<int> _cellColors; //!< Current color of each cell.
+    std::vector<int> _cellDrawColors; //!< Palette index each cell is drawn with.
+    std::vector<int> _colorHistogram; //!< Number of cells of each color, updated by recolorBoard.
+    std::vector<uint32_t> _packedColors; //!< _colors, packed for recolorCells.
+    bool _cellCountMismatchReported = false; //!< Reported once per game.
+    bool _invalidColorReported = false; //!< Reported once per game.
+    Heatmaps _heatmaps;
+
+    // The bomb forecast colors the cells of each pending bomb's rays with the color of the bomb that explodes first.
+    bool _showForecast = false;
+    std::vector<Bomb> _bombs; //!< The pending bombs of the current turn.
+    sf::VertexArray _forecastVertices = sf::VertexArray(sf::Triangles); //!< One hexagon per cell, transparent outside rays.
+    std::vector<int> _forecastDelays; //!< Delay of the first bomb that reaches each cell, INT_MAX if none.
+    std::vector<int> _forecastCells; //!< The cells reached by a bomb, so that only they are cleared next turn.
+    TextBatch _forecastText; //!< The countdown of each bomb.
+
+    sf::Vector2f _hexCorners[6];
+    sf::VertexArray _borderVertices = sf::VertexArray(sf::Triangles); //!< One black hexagon per cell.
+    /// An image drawn on the board.
+    struct Sprite
+    {
+        sf::Vector2f position;
+        Assets::ImageID image;
+    };
+
+    std::vector<Sprite> _sprites; //!< Characters, bombs then explosions, in drawing order.
+    SpriteAtlas _atlas;
+    const SpriteAtlas * _sharedAtlas = nullptr; //!< Used instead of _atlas if set (see setSharedAtlas).
+    sf::Vector2f _boardViewportSize; //!< In pixels.
+    TextBatch _pInfoText;
+    sf::VertexArray _pInfoShapes = sf::VertexArray(sf::Triangles);
+    sf::VertexArray _ccdShapes = sf::VertexArray(sf::Triangles);
+    std::vector<sf::VertexArray> _chartLines; //!< One line strip per player.
+    TextBatch _statusText;
+    sf::Vector2f _statusPosition;
+    TextBatch _coordinatesText; //!< Laid out the first time coordinates are shown in a game.
 
     std::vector<netorcai::PlayerInfo> _playersInfo;
+    std::vector<int> _pInfoOrder; //!< Display order of _playersInfo. Kept across turns so that re-sorting is incremental.
+    std::vector<int> _pInfoScores; //!< Score of each _playersInfo entry, cached for sorting.
+    int _currentTurnNumber = 0;
+    int _lastTurnNumber = 0;
+    float _panelHeight = 600.f;
     std::map<int, int> _score;
     std::map<int, int> _cellCount;
+    StatsStore _stats;
     int _nbNeutralCells = 0;
     std::string _status;
 
     std::vector<sf::Color> _colors;
     sf::FloatRect _boardBoundingBox;
+    sf::View _areaView;
     sf::View _boardView;
     sf::View _playersInfoView;
     sf::View _cellCountDistributionView;
 
+    static const int _verticesPerHex = 18;
+    const int _cellsPerJob = 4096;
+    const int _spritesPerJob = 1024;
     const float _textureSize = 256.0f;
     const float _hexBaseLength = 128.0f;
     const float _hexOutlineThickness = 8.0f;
@@ -92,6 +276,12 @@ private:
     const sf::Vector2f _bombScale = sf::Vector2f(0.5f, 0.5f);
     const sf::Vector2f _explosionScale = sf::Vector2f(0.7f, 0.7f);
     const float _piRectWidth = 280.f;
+    static const unsigned int _statusCharacterSize = 20;
+    static const unsigned int _piCharacterSize = 20;
+    static const unsigned int _piCompactCharacterSize = 14;
+    static const unsigned int _boardCharacterSize = 64; //!< Coordinates and bomb countdowns, scaled down by their view.
+    const float _piCompactRowHeight = 18.f;
+    const float _chartHeight = 150.f;
     const float _ccdWidth = 100.f;
     const float _ccdHeight = 10.f;
     const float _ccdHeightRatioInScreen = 0.02f;
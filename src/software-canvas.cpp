@@ -0,0 +1,370 @@
+#include "software-canvas.hpp"
+
+#include <math.h>
+#include <string.h>
+
+#include <algorithm>
+#include <limits>
+
+#include "board-kernels.hpp"
+
+static sf::Color unpackColor(uint32_t packed)
+{
+    sf::Uint8 bytes[4];
+    memcpy(bytes, &packed, sizeof(packed));
+    return sf::Color(bytes[0], bytes[1], bytes[2], bytes[3]);
+}
+
+/// Twice the signed area of (a, b, p). Positive if p is on the right of a->b, with y pointing down.
+static float edgeFunction(sf::Vector2f a, sf::Vector2f b, sf::Vector2f p)
+{
+    return (b.x - a.x) * (p.y - a.y) - (b.y - a.y) * (p.x - a.x);
+}
+
+/// Whether pixels exactly on the edge a->b belong to the triangle (top-left rule), so that shared edges are drawn once.
+static bool isTopLeftEdge(sf::Vector2f a, sf::Vector2f b)
+{
+    return b.y < a.y || (b.y == a.y && b.x > a.x);
+}
+
+void SoftwareCanvas::create(unsigned int width, unsigned int height)
+{
+    _width = width;
+    _height = height;
+    _pixels.resize((size_t) width * height);
+    _clip = sf::IntRect(0, 0, _width, _height);
+}
+
+void SoftwareCanvas::setThreadPool(ThreadPool * threadPool)
+{
+    _threadPool = threadPool;
+}
+
+void SoftwareCanvas::setFontImages(const Assets * assets)
+{
+    _fontImages = assets;
+}
+
+void SoftwareCanvas::clear(sf::Color color)
+{
+    std::fill(_pixels.begin(), _pixels.end(), packColor(color));
+}
+
+void SoftwareCanvas::setView(const sf::View & view)
+{
+    // Same rounding as sf::RenderTarget::getViewport.
+    const sf::FloatRect & viewport = view.getViewport();
+    const sf::IntRect rect((int)(0.5f + _width * viewport.left), (int)(0.5f + _height * viewport.top),
+        (int)(0.5f + _width * viewport.width), (int)(0.5f + _height * viewport.height));
+
+    // The view maps its coordinates to [-1, 1] (y up), then to the viewport, as sf::RenderTarget::mapCoordsToPixel.
+    const float halfWidth = rect.width / 2.f;
+    const float halfHeight = rect.height / 2.f;
+    _transform = sf::Transform(halfWidth, 0.f, rect.left + halfWidth,
+                               0.f, -halfHeight, rect.top + halfHeight,
+                               0.f, 0.f, 1.f) * view.getTransform();
+
+    const int left = std::max(0, rect.left);
+    const int top = std::max(0, rect.top);
+    _clip.left = left;
+    _clip.top = top;
+    _clip.width = std::max(0, std::min(_width, rect.left + rect.width) - left);
+    _clip.height = std::max(0, std::min(_height, rect.top + rect.height) - top);
+}
+
+void SoftwareCanvas::fillViewport(sf::Color color)
+{
+    for (int y = _clip.top; y < _clip.top + _clip.height; y++)
+        fillSpan(&_pixels[(size_t) y * _width], _clip.left, _clip.left + _clip.width, color);
+}
+
+void SoftwareCanvas::draw(const sf::VertexArray & vertices, const sf::Image * texture)
+{
+    const sf::PrimitiveType type = vertices.getPrimitiveType();
+    if (vertices.getVertexCount() == 0 || (type != sf::Triangles && type != sf::Lines && type != sf::LineStrip))
+        return;
+
+    transformVertices(vertices, 1);
+    if (type == sf::Triangles)
+        forEachBand([&](int top, int bottom) { drawTriangles(vertices, texture, top, bottom); });
+    else
+        forEachBand([&](int top, int bottom) { drawLines(vertices, type == sf::LineStrip, top, bottom); });
+}
+
+void SoftwareCanvas::draw(const TextBatch & text)
+{
+    if (text.empty() || text.texture() == nullptr)
+        return;
+
+    // Glyphs are rendered by the font into its texture, so the texture is the only copy of them.
+    // Frozen glyphs keep their place in the texture, even if other glyphs are added later.
+    // Texts with other glyphs read the texture back, as they may have been added since the previous frame.
+    const sf::Image * image = (_fontImages != nullptr && text.isPrintableAscii()) ? _fontImages->fontImage(text.texture()) : nullptr;
+    if (image == nullptr)
+    {
+        _textImage = text.texture()->copyToImage();
+        image = &_textImage;
+    }
+    draw(text.vertices(), image);
+}
+
+void SoftwareCanvas::drawHexes(const sf::VertexArray & hexes, int verticesPerHex)
+{
+    const int nbHexes = hexes.getVertexCount() / verticesPerHex;
+    if (nbHexes == 0)
+        return;
+
+    updateHexMask(hexes);
+    transformVertices(hexes, verticesPerHex);
+    const int maskTop = _hexMask.empty() ? 0 : _hexMask.front().dy;
+    const int maskBottom = _hexMask.empty() ? -1 : _hexMask.back().dy;
+
+    forEachBand([&](int top, int bottom)
+    {
+        for (int h = 0; h < nbHexes; h++)
+        {
+            const int cx = (int) floorf(_points[h].x + 0.5f);
+            const int cy = (int) floorf(_points[h].y + 0.5f);
+            if (cy + maskBottom < top || cy + maskTop >= bottom)
+                continue;
+
+            const sf::Color color = hexes[h * verticesPerHex].color;
+            for (const Span & span : _hexMask)
+            {
+                const int y = cy + span.dy;
+                if (y < top || y >= bottom)
+                    continue;
+
+                const int left = std::max(_clip.left, cx + span.left);
+                const int right = std::min(_clip.left + _clip.width, cx + span.right);
+                fillSpan(&_pixels[(size_t) y * _width], left, right, color);
+            }
+        }
+    });
+}
+
+bool SoftwareCanvas::saveToFile(const std::string & filename) const
+{
+    if (_pixels.empty())
+        return false;
+
+    sf::Image image;
+    image.create(_width, _height, getPixelsPtr());
+    return image.saveToFile(filename);
+}
+
+void SoftwareCanvas::forEachBand(const std::function<void(int top, int bottom)> & function)
+{
+    const int top = _clip.top;
+    const int bottom = _clip.top + _clip.height;
+    if (bottom <= top)
+        return;
+
+    int nbBands = 1;
+    if (_threadPool != nullptr && _threadPool->size() > 0)
+        nbBands = std::min((_threadPool->size() + 1) * _bandsPerThread, (bottom - top) / _minBandHeight);
+    if (nbBands <= 1)
+    {
+        function(top, bottom);
+        return;
+    }
+
+    _bandTasks.clear();
+    for (int band = 0; band < nbBands; band++)
+    {
+        const int bandTop = top + (bottom - top) * band / nbBands;
+        const int bandBottom = top + (bottom - top) * (band + 1) / nbBands;
+        _bandTasks.push_back([&function, bandTop, bandBottom]() { function(bandTop, bandBottom); });
+    }
+
+    // The pool runs one batch at a time: Board jobs of the renderers, if any, are completed first.
+    _threadPool->wait();
+    _threadPool->run(_bandTasks);
+    _threadPool->wait();
+}
+
+void SoftwareCanvas::transformVertices(const sf::VertexArray & vertices, int stride)
+{
+    const int nbPoints = vertices.getVertexCount() / stride;
+    _points.resize(nbPoints);
+    for (int i = 0; i < nbPoints; i++)
+        _points[i] = _transform.transformPoint(vertices[i * stride].position);
+}
+
+void SoftwareCanvas::updateHexMask(const sf::VertexArray & hexes)
+{
+    // Corners of the first hexagon relative to its center. The transform has no rotation, but may scale.
+    const sf::Vector2f center = _transform.transformPoint(hexes[0].position);
+    sf::Vector2f corners[6];
+    for (int i = 0; i < 6; i++)
+        corners[i] = _transform.transformPoint(hexes[3*i + 1].position) - center;
+
+    if (!_hexMask.empty() && std::equal(corners, corners + 6, _hexCorners))
+        return;
+    std::copy(corners, corners + 6, _hexCorners);
+
+    float minY = corners[0].y;
+    float maxY = corners[0].y;
+    for (const auto & corner : corners)
+    {
+        minY = std::min(minY, corner.y);
+        maxY = std::max(maxY, corner.y);
+    }
+
+    // A pixel belongs to the hexagon if its center does. Hexagons are convex: One span per row.
+    _hexMask.clear();
+    for (int dy = (int) ceilf(minY - 0.5f); dy + 0.5f <= maxY; dy++)
+    {
+        const float y = dy + 0.5f;
+        float left = std::numeric_limits<float>::max();
+        float right = std::numeric_limits<float>::lowest();
+        for (int i = 0; i < 6; i++)
+        {
+            const sf::Vector2f & a = corners[i];
+            const sf::Vector2f & b = corners[(i+1) % 6];
+            if (a.y == b.y || y < std::min(a.y, b.y) || y > std::max(a.y, b.y))
+                continue;
+
+            const float x = a.x + (y - a.y) * (b.x - a.x) / (b.y - a.y);
+            left = std::min(left, x);
+            right = std::max(right, x);
+        }
+
+        const Span span{dy, (int) ceilf(left - 0.5f), (int) ceilf(right - 0.5f)};
+        if (span.right > span.left)
+            _hexMask.push_back(span);
+    }
+}
+
+void SoftwareCanvas::drawTriangles(const sf::VertexArray & vertices, const sf::Image * texture, int top, int bottom)
+{
+    const int clipLeft = _clip.left;
+    const int clipRight = _clip.left + _clip.width;
+    const int textureWidth = texture ? texture->getSize().x : 0;
+    const int textureHeight = texture ? texture->getSize().y : 0;
+    const uint32_t * texels = texture ? reinterpret_cast<const uint32_t *>(texture->getPixelsPtr()) : nullptr;
+    if (texture && (textureWidth == 0 || textureHeight == 0))
+        return;
+
+    const int nbTriangles = vertices.getVertexCount() / 3;
+    for (int t = 0; t < nbTriangles; t++)
+    {
+        int i0 = 3*t, i1 = 3*t + 1, i2 = 3*t + 2;
+        float area = edgeFunction(_points[i0], _points[i1], _points[i2]);
+        if (area == 0.f)
+            continue;
+        if (area < 0.f)
+        {
+            std::swap(i1, i2);
+            area = -area;
+        }
+
+        const sf::Vector2f p0 = _points[i0], p1 = _points[i1], p2 = _points[i2];
+        const int xMin = std::max(clipLeft, (int) floorf(std::min({p0.x, p1.x, p2.x})));
+        const int xMax = std::min(clipRight - 1, (int) ceilf(std::max({p0.x, p1.x, p2.x})));
+        const int yMin = std::max(top, (int) floorf(std::min({p0.y, p1.y, p2.y})));
+        const int yMax = std::min(bottom - 1, (int) ceilf(std::max({p0.y, p1.y, p2.y})));
+        if (xMin > xMax || yMin > yMax)
+            continue;
+
+        const sf::Vertex & v0 = vertices[i0];
+        const sf::Vertex & v1 = vertices[i1];
+        const sf::Vertex & v2 = vertices[i2];
+        const bool isFlat = v0.color == v1.color && v0.color == v2.color;
+        const bool topLeft0 = isTopLeftEdge(p1, p2);
+        const bool topLeft1 = isTopLeftEdge(p2, p0);
+        const bool topLeft2 = isTopLeftEdge(p0, p1);
+
+        for (int y = yMin; y <= yMax; y++)
+        {
+            uint32_t * row = &_pixels[(size_t) y * _width];
+            for (int x = xMin; x <= xMax; x++)
+            {
+                const sf::Vector2f p(x + 0.5f, y + 0.5f);
+                const float e0 = edgeFunction(p1, p2, p);
+                const float e1 = edgeFunction(p2, p0, p);
+                const float e2 = edgeFunction(p0, p1, p);
+                if ((topLeft0 ? e0 < 0.f : e0 <= 0.f) || (topLeft1 ? e1 < 0.f : e1 <= 0.f) || (topLeft2 ? e2 < 0.f : e2 <= 0.f))
+                    continue;
+
+                const float w0 = e0 / area;
+                const float w1 = e1 / area;
+                const float w2 = 1.f - w0 - w1;
+
+                sf::Color color = v0.color;
+                if (!isFlat)
+                {
+                    auto mix = [&](sf::Uint8 c0, sf::Uint8 c1, sf::Uint8 c2) { return (sf::Uint8) std::min(255.f, w0*c0 + w1*c1 + w2*c2 + 0.5f); };
+                    color = sf::Color(mix(v0.color.r, v1.color.r, v2.color.r), mix(v0.color.g, v1.color.g, v2.color.g),
+                        mix(v0.color.b, v1.color.b, v2.color.b), mix(v0.color.a, v1.color.a, v2.color.a));
+                }
+
+                if (texels)
+                {
+                    const float u = w0 * v0.texCoords.x + w1 * v1.texCoords.x + w2 * v2.texCoords.x;
+                    const float v = w0 * v0.texCoords.y + w1 * v1.texCoords.y + w2 * v2.texCoords.y;
+                    const int tx = std::min(textureWidth - 1, std::max(0, (int) u));
+                    const int ty = std::min(textureHeight - 1, std::max(0, (int) v));
+                    color = color * unpackColor(texels[(size_t) ty * textureWidth + tx]);
+                }
+
+                blendPixel(row[x], color);
+            }
+        }
+    }
+}
+
+void SoftwareCanvas::drawLines(const sf::VertexArray & vertices, bool isStrip, int top, int bottom)
+{
+    const int nbVertices = vertices.getVertexCount();
+    const int step = isStrip ? 1 : 2;
+    for (int i = 0; i + 1 < nbVertices; i += step)
+    {
+        // One pixel wide, as OpenGL lines.
+        const sf::Vector2f from = _points[i];
+        const sf::Vector2f to = _points[i + 1];
+        const int nbSteps = std::max(1, (int) ceilf(std::max(fabsf(to.x - from.x), fabsf(to.y - from.y))));
+        const sf::Color color = vertices[i].color;
+
+        for (int s = 0; s <= nbSteps; s++)
+        {
+            const float t = (float) s / nbSteps;
+            const int x = (int) floorf(from.x + t * (to.x - from.x));
+            const int y = (int) floorf(from.y + t * (to.y - from.y));
+            if (y >= top && y < bottom && x >= _clip.left && x < _clip.left + _clip.width)
+                blendPixel(_pixels[(size_t) y * _width + x], color);
+        }
+    }
+}
+
+void SoftwareCanvas::fillSpan(uint32_t * row, int left, int right, sf::Color color)
+{
+    if (left >= right || color.a == 0)
+        return;
+
+    if (color.a == 255)
+        std::fill(row + left, row + right, packColor(color));
+    else
+    {
+        for (int x = left; x < right; x++)
+            blendPixel(row[x], color);
+    }
+}
+
+void SoftwareCanvas::blendPixel(uint32_t & pixel, sf::Color color)
+{
+    if (color.a == 255)
+    {
+        pixel = packColor(color);
+        return;
+    }
+    if (color.a == 0)
+        return;
+
+    // sf::BlendAlpha: source over destination, with straight alpha.
+    const sf::Color dst = unpackColor(pixel);
+    const int a = color.a;
+    auto mix = [a](int src, int dst) { return (sf::Uint8)((src * a + dst * (255 - a) + 127) / 255); };
+    pixel = packColor(sf::Color(mix(color.r, dst.r), mix(color.g, dst.g), mix(color.b, dst.b),
+        (sf::Uint8)(a + (dst.a * (255 - a) + 127) / 255)));
+}
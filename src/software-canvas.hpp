@@ -0,0 +1,113 @@
+#pragma once
+
+#include <stdint.h>
+
+#include <functional>
+#include <string>
+#include <vector>
+
+#include <SFML/Graphics.hpp>
+
+#include "assets.hpp"
+#include "text-batch.hpp"
+#include "thread-pool.hpp"
+
+/**
+ * @brief A framebuffer in main memory that the renderer draws into without OpenGL
+ * @details Meant for machines without GPU, where OpenGL falls back to a slow software implementation.
+ *          Only what the renderer draws is supported: triangles (flat, interpolated or textured),
+ *          line strips and hexagons. Hexagons all have the same shape on screen, so they are filled
+ *          from one precomputed list of row spans instead of being rasterized as triangles.
+ *          Rows are split into bands drawn in parallel by the thread pool, if any.
+ *          Textures are sampled from sf::Image with the nearest texel, and blended as sf::BlendAlpha.
+ */
+class SoftwareCanvas
+{
+public:
+    /// Resize the framebuffer. Its content is undefined until the next clear().
+    void create(unsigned int width, unsigned int height);
+    sf::Vector2u getSize() const { return sf::Vector2u(_width, _height); }
+
+    /**
+     * @brief Draw rows in parallel on a pool of worker threads
+     * @details The pool may be shared with renderers: Their pending board jobs are completed first.
+     */
+    void setThreadPool(ThreadPool * threadPool);
+
+    /**
+     * @brief Draw text from the font images of assets (see Assets::freezeFont), if it has them
+     * @details Otherwise, and for texts with other glyphs than printable ASCII, the font texture is read back
+     *          from OpenGL at each text draw. Canvases that draw on several threads must not touch OpenGL,
+     *          so they need frozen fonts, and printable ASCII texts only.
+     */
+    void setFontImages(const Assets * assets);
+
+    /// Fill the whole framebuffer with a color.
+    void clear(sf::Color color);
+
+    /// Set the view of the next draws, as sf::RenderTarget::setView. Draws are clipped to its viewport.
+    void setView(const sf::View & view);
+
+    /// Fill the viewport of the current view with a color.
+    void fillViewport(sf::Color color);
+
+    /**
+     * @brief Draw a vertex array with the current view
+     * @param vertices Triangles, lines or a line strip. Other primitives are ignored.
+     * @param texture The texture the texture coordinates refer to (in texels), or nullptr
+     */
+    void draw(const sf::VertexArray & vertices, const sf::Image * texture = nullptr);
+
+    /// Draw a text batch with the current view. The font texture is read back from OpenGL unless its glyphs are frozen.
+    void draw(const TextBatch & text);
+
+    /**
+     * @brief Draw hexagons with the current view
+     * @param hexes verticesPerHex vertices per hexagon, as a fan of triangles around vertex 0 (the center).
+     *        All hexagons must have the same shape. Each one is filled with the color of its first vertex.
+     * @param verticesPerHex The number of vertices of each hexagon (3 per corner)
+     */
+    void drawHexes(const sf::VertexArray & hexes, int verticesPerHex);
+
+    /// The pixels, as RGBA bytes row by row (same layout as sf::Image).
+    const sf::Uint8 * getPixelsPtr() const { return reinterpret_cast<const sf::Uint8 *>(_pixels.data()); }
+
+    bool saveToFile(const std::string & filename) const;
+
+private:
+    /// The pixels of a hexagon on one row, relative to its center pixel.
+    struct Span
+    {
+        int dy;
+        int left;
+        int right; //!< Exclusive.
+    };
+
+    void forEachBand(const std::function<void(int top, int bottom)> & function);
+    void transformVertices(const sf::VertexArray & vertices, int stride);
+    void updateHexMask(const sf::VertexArray & hexes);
+    void drawTriangles(const sf::VertexArray & vertices, const sf::Image * texture, int top, int bottom);
+    void drawLines(const sf::VertexArray & vertices, bool isStrip, int top, int bottom);
+    void fillSpan(uint32_t * row, int left, int right, sf::Color color);
+    void blendPixel(uint32_t & pixel, sf::Color color);
+
+private:
+    int _width = 0;
+    int _height = 0;
+    std::vector<uint32_t> _pixels; //!< Packed as sf::Color is laid out in memory (see packColor).
+
+    ThreadPool * _threadPool = nullptr;
+    std::vector<std::function<void()> > _bandTasks;
+
+    sf::Transform _transform; //!< From view coordinates to pixels.
+    sf::IntRect _clip; //!< The viewport of the current view, in pixels, within the framebuffer.
+    std::vector<sf::Vector2f> _points; //!< Vertex positions of the current draw, in pixels.
+
+    sf::Vector2f _hexCorners[6]; //!< Corners of the hexagon shape _hexMask was computed for, in pixels.
+    std::vector<Span> _hexMask;
+    sf::Image _textImage; //!< The font texture of the last drawn TextBatch, if not frozen.
+    const Assets * _fontImages = nullptr;
+
+    const int _minBandHeight = 16;
+    const int _bandsPerThread = 4; //!< More bands than threads, as bands are uneven (e.g. panel vs. board).
+};
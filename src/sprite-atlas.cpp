@@ -0,0 +1,110 @@
+#include "sprite-atlas.hpp"
+
+#include <math.h>
+
+#include <algorithm>
+#include <vector>
+
+/**
+ * @brief Box-filter resampling of one line of RGBA pixels
+ * @details Each destination pixel is the average of the source pixels it covers, weighted by coverage.
+ *          This is exact for any downscaling factor, unlike bilinear filtering that skips source pixels.
+ */
+static void resampleLine(const float * src, int srcLength, int srcStride, float * dst, int dstLength, int dstStride)
+{
+    const float scale = (float) srcLength / dstLength;
+    for (int i = 0; i < dstLength; i++)
+    {
+        const float begin = i * scale;
+        const float end = begin + scale;
+        float sum[4] = {0.f, 0.f, 0.f, 0.f};
+
+        for (int j = (int) begin; j < srcLength && j < end; j++)
+        {
+            const float weight = std::min(end, j + 1.f) - std::max(begin, (float) j);
+            for (int c = 0; c < 4; c++)
+                sum[c] += weight * src[j * srcStride + c];
+        }
+
+        for (int c = 0; c < 4; c++)
+            dst[i * dstStride + c] = sum[c] / scale;
+    }
+}
+
+sf::Image SpriteAtlas::resample(const sf::Image & image, unsigned int newSize)
+{
+    const int width = image.getSize().x;
+    const int height = image.getSize().y;
+    const sf::Uint8 * pixels = image.getPixelsPtr();
+
+    // Colors are premultiplied by alpha, so that transparent pixels do not darken the edges.
+    std::vector<float> source(width * height * 4);
+    for (int i = 0; i < width * height; i++)
+    {
+        const float alpha = pixels[4*i + 3] / 255.f;
+        for (int c = 0; c < 3; c++)
+            source[4*i + c] = pixels[4*i + c] * alpha;
+        source[4*i + 3] = pixels[4*i + 3];
+    }
+
+    // Rows first, then columns.
+    std::vector<float> rows(newSize * height * 4);
+    for (int y = 0; y < height; y++)
+        resampleLine(&source[y * width * 4], width, 4, &rows[y * newSize * 4], newSize, 4);
+
+    std::vector<float> resampled(newSize * newSize * 4);
+    for (unsigned int x = 0; x < newSize; x++)
+        resampleLine(&rows[x * 4], height, newSize * 4, &resampled[x * 4], newSize, newSize * 4);
+
+    std::vector<sf::Uint8> result(newSize * newSize * 4);
+    for (unsigned int i = 0; i < newSize * newSize; i++)
+    {
+        const float alpha = resampled[4*i + 3];
+        for (int c = 0; c < 3; c++)
+            result[4*i + c] = (alpha > 0.f) ? (sf::Uint8) std::min(255.f, roundf(resampled[4*i + c] * 255.f / alpha)) : 0;
+        result[4*i + 3] = (sf::Uint8) std::min(255.f, roundf(alpha));
+    }
+
+    sf::Image res;
+    res.create(newSize, newSize, result.data());
+    return res;
+}
+
+bool SpriteAtlas::rasterize(const Assets & assets, float pixelSize, bool withTexture)
+{
+    unsigned int maxImageSize = 0;
+    for (int id = 0; id < Assets::NB_IMAGES; id++)
+        maxImageSize = std::max(maxImageSize, assets.image((Assets::ImageID) id).getSize().x);
+    if (maxImageSize == 0)
+        return false;
+
+    // Images are never upscaled: Beyond their full size, the texture is magnified when drawn.
+    const unsigned int imageSize = std::min(maxImageSize, std::max(_minImageSize, (unsigned int) ceilf(pixelSize)));
+    if (_imageSize > 0 && imageSize <= _imageSize * _rasterizeRatio && imageSize * _rasterizeRatio >= _imageSize)
+        return false;
+
+    // Transparent padding around each image, so that mipmap levels do not bleed between images.
+    const unsigned int padding = std::max(2u, imageSize / 8);
+    const unsigned int cellSize = imageSize + 2 * padding;
+
+    sf::Image & atlas = _image;
+    atlas.create(cellSize * Assets::NB_IMAGES, cellSize, sf::Color::Transparent);
+    for (int id = 0; id < Assets::NB_IMAGES; id++)
+    {
+        // Images that could not be loaded are left transparent.
+        const unsigned int x = id * cellSize + padding;
+        const sf::Image & image = assets.image((Assets::ImageID) id);
+        if (image.getSize().x > 0 && image.getSize().y > 0)
+            atlas.copy(resample(image, imageSize), x, padding);
+        _textureRects[id] = sf::IntRect(x, padding, imageSize, imageSize);
+    }
+
+    if (withTexture)
+    {
+        _texture.loadFromImage(atlas);
+        _texture.setSmooth(true);
+        _texture.generateMipmap();
+    }
+    _imageSize = imageSize;
+    return true;
+}
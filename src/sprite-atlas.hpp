@@ -0,0 +1,48 @@
+#pragma once
+
+#include <SFML/Graphics.hpp>
+
+#include "assets.hpp"
+
+/**
+ * @brief The Assets images rasterized at their display size into one mipmapped texture
+ * @details Drawing 256px images a few dozen pixels wide aliases and wastes fill rate.
+ *          The atlas resamples every image to the size it is actually displayed at,
+ *          and is rasterized again only when that size changes significantly.
+ *          All images share one texture, so that all sprites can be drawn in one draw call.
+ */
+class SpriteAtlas
+{
+public:
+    /**
+     * @brief Rasterize the images so that they are displayed about pixelSize pixels wide
+     * @details Does nothing if the current rasterization is close enough to pixelSize.
+     *          Must be called from the rendering thread, once the images of assets are ready.
+     * @param withTexture Whether to load the texture as well. Without it, only image() is set, and no OpenGL is used.
+     * @return Whether the atlas has been rasterized again (texture rectangles changed)
+     */
+    bool rasterize(const Assets & assets, float pixelSize, bool withTexture = true);
+
+    /// Whether the atlas has been rasterized at least once.
+    bool isReady() const { return _imageSize > 0; }
+
+    const sf::Texture & texture() const { return _texture; }
+
+    /// The atlas in main memory, without mipmaps. Same texture rectangles as texture().
+    const sf::Image & image() const { return _image; }
+
+    /// The texture rectangle of an image. Images are square.
+    const sf::IntRect & textureRect(Assets::ImageID id) const { return _textureRects[id]; }
+
+private:
+    static sf::Image resample(const sf::Image & image, unsigned int newSize);
+
+private:
+    unsigned int _imageSize = 0; //!< Side of each image in the atlas, in pixels.
+    sf::Texture _texture;
+    sf::Image _image;
+    sf::IntRect _textureRects[Assets::NB_IMAGES];
+
+    const unsigned int _minImageSize = 16;
+    const float _rasterizeRatio = 1.25f; //!< Rasterize again when the display size changes by more than this factor.
+};
@@ -0,0 +1,223 @@
+#include "stats.hpp"
+
+#include <stdio.h>
+
+#include <algorithm>
+
+StatsStore::StatsStore(int capacity) :
+    _capacity(std::max(4, capacity))
+{
+}
+
+void StatsStore::reset(const std::vector<int> & playerIDs)
+{
+    _playerIDs = playerIDs;
+
+    const int maxPlayerID = playerIDs.empty() ? -1 : *std::max_element(playerIDs.begin(), playerIDs.end());
+    _playerIndexFromColor.assign(maxPlayerID + 2, -1);
+    for (unsigned int i = 0; i < playerIDs.size(); i++)
+        _playerIndexFromColor[playerIDs[i] + 1] = i;
+
+    _turns.clear();
+    _turns.reserve(_capacity);
+    // Columns are only added: Those of a previous game with more players keep their buffers for the next ones.
+    _nbColumns = NB_SERIES * playerIDs.size();
+    if (_columns.size() < (size_t) _nbColumns)
+        _columns.resize(_nbColumns);
+    for (auto & column : _columns)
+    {
+        column.clear();
+        column.reserve(_capacity);
+    }
+
+    _previousBombs.clear();
+}
+
+void StatsStore::append(int turnNumber,
+    const std::vector<Character> & characters,
+    const std::vector<Bomb> & bombs,
+    const std::unordered_map<int, std::vector<Coordinates> > & explosions,
+    const std::map<int, int> & score,
+    const std::map<int, int> & cellCount)
+{
+    const int nbPlayers = _playerIDs.size();
+    if (!_turns.empty() && _turns.back() == turnNumber)
+    {
+        // Gauges are replaced, counters keep adding up.
+        for (int i = 0; i < nbPlayers; i++)
+        {
+            mutableColumn(SCORE, i).back() = 0;
+            mutableColumn(CELL_COUNT, i).back() = 0;
+            mutableColumn(ALIVE_CHARACTERS, i).back() = 0;
+        }
+    }
+    else
+    {
+        if (_turns.size() >= (size_t)_capacity)
+            downsample();
+
+        _turns.push_back(turnNumber);
+        for (int i = 0; i < _nbColumns; i++)
+            _columns[i].push_back(0);
+    }
+
+    auto playerIndex = [this](int color)
+    {
+        if (color < 0 || color >= (int)_playerIndexFromColor.size())
+            return -1;
+        return _playerIndexFromColor[color];
+    };
+
+    for (int i = 0; i < nbPlayers; i++)
+    {
+        auto it = score.find(_playerIDs[i]);
+        if (it != score.end())
+            mutableColumn(SCORE, i).back() = it->second;
+
+        it = cellCount.find(_playerIDs[i]);
+        if (it != cellCount.end())
+            mutableColumn(CELL_COUNT, i).back() = it->second;
+    }
+
+    for (const auto & character : characters)
+    {
+        const int index = playerIndex(character.color);
+        if (index >= 0 && character.isAlive)
+            mutableColumn(ALIVE_CHARACTERS, index).back()++;
+    }
+
+    // A bomb is new if no bomb of the same color was at the same place last turn.
+    _currentBombs.clear();
+    for (const auto & bomb : bombs)
+        _currentBombs.push_back(std::make_tuple(bomb.coord.q, bomb.coord.r, bomb.color));
+    std::sort(_currentBombs.begin(), _currentBombs.end());
+
+    for (const auto & key : _currentBombs)
+    {
+        const int index = playerIndex(std::get<2>(key));
+        if (index >= 0 && !std::binary_search(_previousBombs.begin(), _previousBombs.end(), key))
+            mutableColumn(BOMBS_PLACED, index).back()++;
+    }
+    std::swap(_previousBombs, _currentBombs);
+
+    for (const auto & [color, coords] : explosions)
+    {
+        const int index = playerIndex(color);
+        if (index >= 0)
+            mutableColumn(EXPLOSION_AREA, index).back() += coords.size();
+    }
+}
+
+void StatsStore::downsample()
+{
+    // Merge the rows of the oldest half two by two, then move the recent half next to them.
+    const int nbRows = _turns.size();
+    const int half = (nbRows / 2) & ~1;
+    const int merged = half / 2;
+
+    for (int i = 0; i < merged; i++)
+        _turns[i] = _turns[2*i+1];
+    std::copy(_turns.begin() + half, _turns.end(), _turns.begin() + merged);
+    _turns.resize(nbRows - merged);
+
+    for (int series = 0; series < NB_SERIES; series++)
+    {
+        // Gauges keep the value at the end of the merged rows, counters are summed.
+        const bool isCounter = (series == BOMBS_PLACED || series == EXPLOSION_AREA);
+
+        for (unsigned int p = 0; p < _playerIDs.size(); p++)
+        {
+            auto & column = mutableColumn((Series) series, p);
+            for (int i = 0; i < merged; i++)
+                column[i] = isCounter ? column[2*i] + column[2*i+1] : column[2*i+1];
+            std::copy(column.begin() + half, column.end(), column.begin() + merged);
+            column.resize(nbRows - merged);
+        }
+    }
+}
+
+int StatsStore::nbRows() const
+{
+    return _turns.size();
+}
+
+const std::vector<int> & StatsStore::playerIDs() const
+{
+    return _playerIDs;
+}
+
+const std::vector<int> & StatsStore::turns() const
+{
+    return _turns;
+}
+
+const std::vector<int> & StatsStore::column(Series series, int playerIndex) const
+{
+    return _columns[series * _playerIDs.size() + playerIndex];
+}
+
+std::vector<int> & StatsStore::mutableColumn(Series series, int playerIndex)
+{
+    return _columns[series * _playerIDs.size() + playerIndex];
+}
+
+int StatsStore::maxValue(Series series) const
+{
+    int maxValue = 0;
+    for (unsigned int p = 0; p < _playerIDs.size(); p++)
+    {
+        const auto & values = column(series, p);
+        if (!values.empty())
+            maxValue = std::max(maxValue, *std::max_element(values.begin(), values.end()));
+    }
+
+    return maxValue;
+}
+
+bool StatsStore::exportCSV(const std::string & filename) const
+{
+    FILE * f = fopen(filename.c_str(), "w");
+    if (f == nullptr)
+        return false;
+
+    fprintf(f, "turn,player_id");
+    for (int series = 0; series < NB_SERIES; series++)
+        fprintf(f, ",%s", seriesName((Series) series));
+    fprintf(f, "\n");
+
+    for (int row = 0; row < nbRows(); row++)
+    {
+        for (unsigned int p = 0; p < _playerIDs.size(); p++)
+        {
+            fprintf(f, "%d,%d", _turns[row], _playerIDs[p]);
+            for (int series = 0; series < NB_SERIES; series++)
+                fprintf(f, ",%d", column((Series) series, p)[row]);
+            fprintf(f, "\n");
+        }
+    }
+
+    return fclose(f) == 0;
+}
+
+size_t StatsStore::memoryUsage() const
+{
+    size_t bytes = (_playerIDs.capacity() + _playerIndexFromColor.capacity() + _turns.capacity()) * sizeof(int)
+        + _columns.capacity() * sizeof(std::vector<int>)
+        + (_previousBombs.capacity() + _currentBombs.capacity()) * sizeof(std::tuple<int, int, int>);
+    for (const auto & column : _columns)
+        bytes += column.capacity() * sizeof(int);
+    return bytes;
+}
+
+const char * StatsStore::seriesName(Series series)
+{
+    switch (series)
+    {
+        case SCORE: return "score";
+        case CELL_COUNT: return "cell_count";
+        case ALIVE_CHARACTERS: return "alive_characters";
+        case BOMBS_PLACED: return "bombs_placed";
+        case EXPLOSION_AREA: return "explosion_area";
+        default: return "unknown";
+    }
+}
@@ -0,0 +1,76 @@
+#pragma once
+
+#include <map>
+#include <string>
+#include <tuple>
+#include <unordered_map>
+#include <vector>
+
+#include "hexabomb-parse.hpp"
+
+/**
+ * @brief Per-turn statistics of each player of a game, stored column by column
+ * @details Memory is bounded: Once capacity rows are stored, the oldest half of the rows is
+ *          downsampled by merging consecutive rows. Recent turns thus keep a per-turn resolution
+ *          while old turns get coarser. Each row is identified by the last turn it covers.
+ */
+class StatsStore
+{
+public:
+    enum Series
+    {
+        SCORE,            //!< Player score. Value at the end of the row.
+        CELL_COUNT,       //!< Number of cells of the player. Value at the end of the row.
+        ALIVE_CHARACTERS, //!< Number of alive characters of the player. Value at the end of the row.
+        BOMBS_PLACED,     //!< Number of bombs placed by the player during the row.
+        EXPLOSION_AREA,   //!< Number of cells exploded by the player bombs during the row.
+        NB_SERIES
+    };
+
+    explicit StatsStore(int capacity = 1024);
+
+    /// Forget all rows and set the players of the next game.
+    void reset(const std::vector<int> & playerIDs);
+
+    /**
+     * @brief Append the statistics of a turn
+     * @details A turn with the same number as the last row updates it instead, as GAME_ENDS does after the last turn.
+     */
+    void append(int turnNumber,
+        const std::vector<Character> & characters,
+        const std::vector<Bomb> & bombs,
+        const std::unordered_map<int, std::vector<Coordinates> > & explosions,
+        const std::map<int, int> & score,
+        const std::map<int, int> & cellCount);
+
+    int nbRows() const;
+    const std::vector<int> & playerIDs() const;
+    const std::vector<int> & turns() const;
+    const std::vector<int> & column(Series series, int playerIndex) const;
+    int maxValue(Series series) const;
+
+    /**
+     * @brief Write all rows in a CSV file (one line per row and player)
+     * @return Whether the file could be written
+     */
+    bool exportCSV(const std::string & filename) const;
+
+    /// The heap memory held, in bytes.
+    size_t memoryUsage() const;
+
+    static const char * seriesName(Series series);
+
+private:
+    std::vector<int> & mutableColumn(Series series, int playerIndex);
+    void downsample();
+
+private:
+    int _capacity;
+    std::vector<int> _playerIDs;
+    std::vector<int> _playerIndexFromColor; //!< Cell color is playerID+1.
+    std::vector<int> _turns;
+    std::vector<std::vector<int> > _columns; //!< Indexed by series * nbPlayers + playerIndex. May hold unused columns.
+    int _nbColumns = 0; //!< The columns of the current players.
+    std::vector<std::tuple<int, int, int> > _previousBombs; //!< (q, r, color) of last turn bombs, sorted.
+    std::vector<std::tuple<int, int, int> > _currentBombs;
+};
@@ -0,0 +1,82 @@
+#include "text-batch.hpp"
+
+void TextBatch::setFont(const sf::Font & font)
+{
+    _font = &font;
+}
+
+void TextBatch::setCharacterSize(unsigned int characterSize)
+{
+    _characterSize = characterSize;
+}
+
+unsigned int TextBatch::getCharacterSize() const
+{
+    return _characterSize;
+}
+
+void TextBatch::clear()
+{
+    _vertices.clear();
+    _isPrintableAscii = true;
+}
+
+void TextBatch::append(const std::string & str, sf::Vector2f position, sf::Color color)
+{
+    if (_font == nullptr)
+        return;
+
+    // Same layout as sf::Text: the baseline of the first line is one character size below the top.
+    const sf::String utf32 = sf::String::fromUtf8(str.begin(), str.end());
+    float x = position.x;
+    const float y = position.y + _characterSize;
+
+    sf::Uint32 previous = 0;
+    for (const sf::Uint32 c : utf32)
+    {
+        if (c == '\n')
+            break;
+
+        x += _font->getKerning(previous, c, _characterSize);
+        previous = c;
+        if (c < ' ' || c > '~')
+            _isPrintableAscii = false;
+
+        const sf::Glyph & glyph = _font->getGlyph(c, _characterSize, false);
+        if (glyph.textureRect.width > 0 && glyph.textureRect.height > 0)
+        {
+            const float left = x + glyph.bounds.left;
+            const float top = y + glyph.bounds.top;
+            const float right = left + glyph.bounds.width;
+            const float bottom = top + glyph.bounds.height;
+
+            const float u1 = glyph.textureRect.left;
+            const float v1 = glyph.textureRect.top;
+            const float u2 = u1 + glyph.textureRect.width;
+            const float v2 = v1 + glyph.textureRect.height;
+
+            _vertices.append(sf::Vertex(sf::Vector2f(left, top), color, sf::Vector2f(u1, v1)));
+            _vertices.append(sf::Vertex(sf::Vector2f(right, top), color, sf::Vector2f(u2, v1)));
+            _vertices.append(sf::Vertex(sf::Vector2f(left, bottom), color, sf::Vector2f(u1, v2)));
+            _vertices.append(sf::Vertex(sf::Vector2f(left, bottom), color, sf::Vector2f(u1, v2)));
+            _vertices.append(sf::Vertex(sf::Vector2f(right, top), color, sf::Vector2f(u2, v1)));
+            _vertices.append(sf::Vertex(sf::Vector2f(right, bottom), color, sf::Vector2f(u2, v2)));
+        }
+
+        x += glyph.advance;
+    }
+}
+
+const sf::Texture * TextBatch::texture() const
+{
+    return _font ? &_font->getTexture(_characterSize) : nullptr;
+}
+
+void TextBatch::draw(sf::RenderTarget & target, sf::RenderStates states) const
+{
+    if (_font == nullptr || _vertices.getVertexCount() == 0)
+        return;
+
+    states.texture = texture();
+    target.draw(_vertices, states);
+}
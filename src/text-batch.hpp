@@ -0,0 +1,48 @@
+#pragma once
+
+#include <string>
+
+#include <SFML/Graphics.hpp>
+
+/**
+ * @brief Many short texts of the same font and size, drawn as one glyph vertex array.
+ * @details Drawing a sf::Text costs one draw call per text. A TextBatch lays out all
+ *          its strings into a single vertex array that references the font texture,
+ *          so drawing it costs one draw call regardless of the number of strings.
+ */
+class TextBatch : public sf::Drawable
+{
+public:
+    void setFont(const sf::Font & font);
+    void setCharacterSize(unsigned int characterSize);
+    unsigned int getCharacterSize() const;
+
+    void clear();
+    bool empty() const { return _vertices.getVertexCount() == 0; }
+
+    /// Whether only printable ASCII characters have been laid out since the last clear (see Assets::freezeFont).
+    bool isPrintableAscii() const { return _isPrintableAscii; }
+
+    /**
+     * @brief Append a string to the batch
+     * @param str The UTF-8 string to append. Only the first line is laid out.
+     * @param position The top-left corner of the string, as for sf::Text::setPosition.
+     * @param color The glyphs color.
+     */
+    void append(const std::string & str, sf::Vector2f position, sf::Color color = sf::Color::Black);
+
+    /// The glyph quads, as triangles. Texture coordinates refer to texture().
+    const sf::VertexArray & vertices() const { return _vertices; }
+
+    /// The font texture of the character size, or nullptr without font.
+    const sf::Texture * texture() const;
+
+private:
+    void draw(sf::RenderTarget & target, sf::RenderStates states) const override;
+
+private:
+    const sf::Font * _font = nullptr;
+    unsigned int _characterSize = 20;
+    sf::VertexArray _vertices = sf::VertexArray(sf::Triangles);
+    bool _isPrintableAscii = true;
+};
@@ -0,0 +1,101 @@
+#include "thread-pool.hpp"
+
+ThreadPool::ThreadPool(int nbThreads)
+{
+    for (int i = 0; i < nbThreads; i++)
+        _threads.emplace_back(&ThreadPool::workerLoop, this);
+}
+
+ThreadPool::~ThreadPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _shouldQuit = true;
+    }
+    _batchAvailable.notify_all();
+
+    for (auto & thread : _threads)
+        thread.join();
+}
+
+void ThreadPool::run(const std::vector<std::function<void()> > & tasks)
+{
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _tasks = &tasks;
+        _nextTask = 0;
+        _nbRemainingTasks = tasks.size();
+        _batchNumber++;
+    }
+    _batchAvailable.notify_all();
+}
+
+void ThreadPool::wait()
+{
+    if (_tasks == nullptr)
+        return;
+
+    while (runNextTask()) {}
+
+    // Workers may still be running their last task.
+    std::unique_lock<std::mutex> lock(_mutex);
+    _batchDone.wait(lock, [this]() { return _nbRemainingTasks == 0 && _nbActiveWorkers == 0; });
+    _tasks = nullptr;
+}
+
+bool ThreadPool::tryWait()
+{
+    if (_tasks == nullptr)
+        return true;
+
+    std::lock_guard<std::mutex> lock(_mutex);
+    if (_nbRemainingTasks != 0 || _nbActiveWorkers != 0)
+        return false;
+
+    _tasks = nullptr;
+    return true;
+}
+
+bool ThreadPool::runNextTask()
+{
+    const int index = _nextTask.fetch_add(1);
+    if (index >= (int) _tasks->size())
+        return false;
+
+    (*_tasks)[index]();
+
+    if (_nbRemainingTasks.fetch_sub(1) == 1)
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _batchDone.notify_all();
+    }
+    return true;
+}
+
+void ThreadPool::workerLoop()
+{
+    int seenBatchNumber = 0;
+    for (;;)
+    {
+        {
+            std::unique_lock<std::mutex> lock(_mutex);
+            _batchAvailable.wait(lock, [&]() { return _shouldQuit || _batchNumber != seenBatchNumber; });
+            if (_shouldQuit)
+                return;
+
+            // The batch may already be over if this worker woke up late.
+            seenBatchNumber = _batchNumber;
+            if (_tasks == nullptr)
+                continue;
+            _nbActiveWorkers++;
+        }
+
+        while (runNextTask()) {}
+
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _nbActiveWorkers--;
+        }
+        _batchDone.notify_all();
+    }
+}
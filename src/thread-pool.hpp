@@ -0,0 +1,58 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+ * @brief A small pool of worker threads that run batches of independent tasks
+ * @details Tasks are taken in order from a shared counter by whichever thread is free,
+ *          so that uneven tasks balance between workers. The thread that waits for a batch
+ *          runs tasks as well instead of sleeping. Only one batch runs at a time.
+ */
+class ThreadPool
+{
+public:
+    /// Start nbThreads worker threads. With 0 threads, tasks run in wait().
+    explicit ThreadPool(int nbThreads);
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool &) = delete;
+    ThreadPool & operator=(const ThreadPool &) = delete;
+
+    /// The number of worker threads.
+    int size() const { return _threads.size(); }
+
+    /**
+     * @brief Start running a batch of tasks on the workers
+     * @param tasks The tasks. Must stay valid until wait() returns.
+     * @details The previous batch must have been waited for.
+     */
+    void run(const std::vector<std::function<void()> > & tasks);
+
+    /// Help running the tasks of the current batch, then wait until they are all done.
+    void wait();
+
+    /// Whether the tasks of the current batch are all done, without waiting nor running tasks.
+    bool tryWait();
+
+private:
+    void workerLoop();
+    bool runNextTask();
+
+private:
+    std::vector<std::thread> _threads;
+    std::mutex _mutex;
+    std::condition_variable _batchAvailable;
+    std::condition_variable _batchDone;
+
+    const std::vector<std::function<void()> > * _tasks = nullptr; //!< The current batch, null between batches.
+    std::atomic<int> _nextTask{0};
+    std::atomic<int> _nbRemainingTasks{0};
+    int _nbActiveWorkers = 0; //!< Workers taking tasks from the current batch.
+    int _batchNumber = 0;
+    bool _shouldQuit = false;
+};
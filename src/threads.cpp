@@ -1,128 +1,328 @@
 #include "threads.hpp"
 
+#include <math.h>
+#include <string.h>
+
+#include <algorithm>
+#include <limits>
+#include <memory>
+
 #include <netorcai-client-cpp/client.hpp>
 #include <netorcai-client-cpp/error.hpp>
 
+#ifdef HEXABOMB_VISU_COUNT_ALLOCATIONS
+#include "allocation-counter.hpp"
+#endif
+#ifdef HEXABOMB_VISU_MJPEG
+#include "frame-readback.hpp"
+#include "mjpeg-stream.hpp"
+#endif
+#include "game-log.hpp"
 #include "hexabomb-parse.hpp"
+#include "metrics.hpp"
+#include "playout-buffer.hpp"
 #include "renderer.hpp"
+#include "software-canvas.hpp"
+#include "trace.hpp"
+#include "turn-digest.hpp"
+#include "util.hpp"
 
 using namespace netorcai;
 
+/// In a session, delay between two connection attempts to netorcai.
+static const int sessionRetryDelayMs = 100;
+
+/// TURN_ACK with no action. Only the turn number is filled in.
+static const char turnAckFormat[] = R"({"message_type":"TURN_ACK","turn_number":%d,"actions":[]})";
+
+ObjectPool<TurnMessage> & turn_message_pool()
+{
+    // Few turns are in flight at once, as the network thread skips turns while the renderer is late.
+    static ObjectPool<TurnMessage> pool(64);
+    return pool;
+}
+
+Wakeup & renderer_wakeup()
+{
+    static Wakeup wakeup;
+    return wakeup;
+}
+
+/// Read the players_info of a netorcai message into an existing vector, reusing its strings.
+static void readPlayersInfo(const json & playersInfo, std::vector<PlayerInfo> & players)
+{
+    players.resize(playersInfo.size());
+    for (size_t i = 0; i < players.size(); i++)
+    {
+        const json & player = playersInfo[i];
+        players[i].playerID = player["player_id"];
+        players[i].nickname = player["nickname"].get_ref<const std::string &>();
+        players[i].remoteAddress = player["remote_address"].get_ref<const std::string &>();
+        players[i].isConnected = player["is_connected"];
+    }
+}
+
 void network_thread_function(boost::lockfree::queue<Message> * from_renderer,
     boost::lockfree::queue<Message> * to_renderer,
-    const std::string & hostname, uint16_t port)
+    const std::string & hostname, uint16_t port,
+    boost::lockfree::queue<Message> * to_relay,
+    const std::string & recordFilename,
+    bool persistent,
+    GameMetrics * gameMetrics)
 {
-    try
+    // Forward a message to the renderer.
+    auto push = [to_renderer, gameMetrics](const Message & msg)
+    {
+        to_renderer->push(msg);
+        gameMetrics->messagesPushed.add();
+        renderer_wakeup().notify();
+    };
+
+    // Forward a message to the relay, if any.
+    auto relay = [to_relay](MessageType type, void * data)
     {
-        netorcai::Client c;
+        if (to_relay == nullptr)
+            return;
+
         Message msg;
-        GameStartsMessage * gameStarts = nullptr;
-        GameEndsMessage * gameEnds = nullptr;
-        TurnMessage * turn = nullptr;
-        bool shouldQuit = false;
+        msg.type = type;
+        msg.data = data;
+        to_relay->push(msg);
+    };
 
-        printf("Connecting to netorcai (%s:%d)... ", hostname.c_str(), port); fflush(stdout);
-        c.connect(hostname, port);
-        printf("done\n");
+    // Forward an error to the renderer and to the relay.
+    auto forwardError = [&](const char * reason)
+    {
+        Message msg;
+        msg.type = MessageType::ERROR;
+        asprintf((char**)&msg.data, "%s", reason);
+        relay(MessageType::ERROR, strdup(reason));
+        push(msg);
+    };
 
-        printf("Logging in as a visualization... "); fflush(stdout);
-        c.sendLogin("sfml-visu", "visualization");
-        c.readLoginAck();
-        printf("done\n");
+    // Look whether termination has been requested.
+    auto terminationRequested = [from_renderer]()
+    {
+        Message msg;
+        return from_renderer->pop(msg) && msg.type == MessageType::TERMINATE;
+    };
+
+    GameLogWriter log;
+    if (!recordFilename.empty() && !log.open(recordFilename))
+    {
+        printf("Cannot record the game to %s\n", recordFilename.c_str());
+        fflush(stdout);
+    }
+
+    // Reused between messages, so that receiving a turn does not allocate them again.
+    TurnDigester digester;
+    std::string msgStr;
+    std::string turnAck;
+    char turnAckBuffer[96];
+#ifdef HEXABOMB_VISU_COUNT_ALLOCATIONS
+    size_t lastAllocationCount = threadAllocationCount();
+#endif
+
+    trace::setThreadName("network " + hostname + ":" + std::to_string(port));
 
-        while (!shouldQuit)
+    bool shouldQuit = false;
+    bool verbose = true; // In a session, failed reconnections are only reported once.
+    while (!shouldQuit)
+    {
+        try
         {
-            std::string msgStr;
-            if (c.recvStringNonBlocking(msgStr, 5.0))
+            netorcai::Client c;
+            Message msg;
+            GameStartsMessage * gameStarts = nullptr;
+            GameEndsMessage * gameEnds = nullptr;
+            TurnMessage * turn = nullptr;
+            bool gameEnded = false;
+
+            if (verbose)
+            {
+                printf("Connecting to netorcai (%s:%d)... ", hostname.c_str(), port); fflush(stdout);
+            }
+            c.connect(hostname, port);
+            if (!verbose)
             {
-                // A message has been received.
-                json msgJson = json::parse(msgStr);
-                if (msgJson["message_type"] == "TURN")
+                printf("Connected to netorcai (%s:%d)\n", hostname.c_str(), port);
+                verbose = true;
+            }
+            else
+                printf("done\n");
+
+            printf("Logging in as a visualization... "); fflush(stdout);
+            c.sendLogin("sfml-visu", "visualization");
+            c.readLoginAck();
+            printf("done\n");
+
+            while (!shouldQuit && !gameEnded)
+            {
+                bool isReceived = false;
+                {
+                    trace::Scope scope("recv");
+                    isReceived = c.recvStringNonBlocking(msgStr, 5.0);
+                }
+                if (isReceived)
                 {
-                    turn = new TurnMessage;
-                    *turn = parseTurnMessage(msgJson);
-                    const int turnNumber = turn->turnNumber;
+                    // A message has been received.
+                    msg.receivedMicroseconds = monotonicMicroseconds();
+                    trace::begin("parse");
+                    json msgJson = json::parse(msgStr);
+                    const std::string & messageType = msgJson["message_type"].get_ref<const std::string &>();
+                    trace::end("parse");
+                    if (messageType == "GAME_STARTS" || messageType == "GAME_ENDS")
+                        log.write(msgStr, msgJson);
+
+                    if (messageType == "TURN")
+                    {
+                        // Send TURN_ACK to netorcai first, so future turns can be received.
+                        // Only the turn number changes, so the message is formatted into a reused buffer.
+                        const int turnNumber = msgJson["turn_number"];
+                        {
+                            trace::Scope scope("ack");
+                            const int turnAckSize = snprintf(turnAckBuffer, sizeof(turnAckBuffer), turnAckFormat, turnNumber);
+                            turnAck.assign(turnAckBuffer, turnAckSize);
+                            c.sendString(turnAck);
+                        }
+                        gameMetrics->turnsReceived.add();
+                        gameMetrics->turnAckLatency.observe(monotonicMicroseconds() - msg.receivedMicroseconds);
+
+                        // Writing the game log may block on the disk: It is done once the turn is acknowledged.
+                        log.write(msgStr, msgJson);
+
+                        // Fill a pooled message in place. The game state is moved out of the parsed message.
+                        turn = turn_message_pool().acquire();
+                        turn->turnNumber = turnNumber;
+                        readPlayersInfo(msgJson["players_info"], turn->playersInfo);
+                        turn->gameState = std::move(msgJson["game_state"]);
+
+                        // Viewers get their own copy, made after the TURN_ACK so that they do not slow the game down.
+                        TurnMessage * relayedTurn = nullptr;
+                        if (to_relay)
+                        {
+                            relayedTurn = turn_message_pool().acquire();
+                            *relayedTurn = *turn;
+                        }
 
-                    printf("Received TURN %d\n", turnNumber+1); fflush(stdout);
+#ifdef HEXABOMB_VISU_COUNT_ALLOCATIONS
+                        const size_t nbAllocations = threadAllocationCount();
+                        printf("Received TURN %d (%zu allocations since previous turn)\n", turnNumber+1, nbAllocations - lastAllocationCount);
+                        lastAllocationCount = nbAllocations;
+#else
+                        printf("Received TURN %d\n", turnNumber+1);
+#endif
+                        fflush(stdout);
 
-                    // Only forward TURN if the queue is empty.
-                    // This avoids flooding the renderer if it is slower than the network.
-                    if (to_renderer->empty())
+                        // Only forward TURN if the queue is empty.
+                        // This avoids flooding the renderer if it is slower than the network.
+                        // Skipped turns are still counted in the statistics, from their digest.
+                        trace::begin("push");
+                        if (to_renderer->empty())
+                        {
+                            digester.track(turn->gameState);
+                            msg.type = MessageType::TURN;
+                            msg.data = (void*) turn;
+                        }
+                        else
+                        {
+                            msg.type = MessageType::SKIPPED_TURN;
+                            msg.data = (void*) digester.digest(turnNumber, turn->gameState);
+                            turn_message_pool().release(turn);
+                            gameMetrics->turnsDropped.add();
+                        }
+                        push(msg);
+                        trace::end("push");
+
+                        relay(MessageType::TURN, relayedTurn);
+                    }
+                    else if (messageType == "KICK")
                     {
-                        msg.type = MessageType::TURN;
-                        msg.data = (void*) turn;
-                        to_renderer->push(msg);
+                        const std::string reason = msgJson["kick_reason"];
+                        printf("Kicked from netorcai. Reason: %s\n", reason.c_str());
+                        fflush(stdout);
+
+                        // In a session, the next netorcai instance may accept us.
+                        if (persistent)
+                            break;
+
+                        forwardError(reason.c_str());
+                        shouldQuit = true;
                     }
-                    else
-                        delete turn;
+                    if (messageType == "GAME_STARTS")
+                    {
+                        printf("Received GAME_STARTS\n"); fflush(stdout);
+                        gameStarts = new GameStartsMessage;
+                        *gameStarts = parseGameStartsMessage(msgJson);
+                        digester.reset(gameStarts->initialGameState);
+                        relay(MessageType::GAME_STARTS, new GameStartsMessage(*gameStarts));
 
-                    // Send TURN_ACK to netorcai, so future turns can be received.
-                    c.sendTurnAck(turnNumber, json::parse(R"([])"));
-                }
-                else if (msgJson["message_type"] == "KICK")
-                {
-                    msg.type = MessageType::ERROR;
-                    asprintf((char**)&msg.data, "%s",
-                        ((std::string)msgJson["kick_reason"]).c_str());
-                    printf("Kicked from netorcai. Reason: %s\n", (char*) msg.data);
-                    fflush(stdout);
-                    to_renderer->push(msg);
-                    shouldQuit = true;
-                }
-                if (msgJson["message_type"] == "GAME_STARTS")
-                {
-                    printf("Received GAME_STARTS\n"); fflush(stdout);
-                    gameStarts = new GameStartsMessage;
-                    *gameStarts = parseGameStartsMessage(msgJson);
+                        msg.type = MessageType::GAME_STARTS;
+                        msg.data = (void*) gameStarts;
+                        push(msg);
+                    }
+                    else if (messageType == "GAME_ENDS")
+                    {
+                        printf("Received GAME_ENDS\n"); fflush(stdout);
+                        log.flush();
+                        gameEnds = new GameEndsMessage;
+                        *gameEnds = parseGameEndsMessage(msgJson);
+                        relay(MessageType::GAME_ENDS, new GameEndsMessage(*gameEnds));
 
-                    msg.type = MessageType::GAME_STARTS;
-                    msg.data = (void*) gameStarts;
-                    to_renderer->push(msg);
+                        msg.type = MessageType::GAME_ENDS;
+                        msg.data = (void*) gameEnds;
+                        push(msg);
+                        gameEnded = true;
+                        shouldQuit = !persistent;
+                    }
                 }
-                else if (msgJson["message_type"] == "GAME_ENDS")
-                {
-                    printf("Received GAME_ENDS\n"); fflush(stdout);
-                    gameEnds = new GameEndsMessage;
-                    *gameEnds = parseGameEndsMessage(msgJson);
 
-                    msg.type = MessageType::GAME_ENDS;
-                    msg.data = (void*) gameEnds;
-                    to_renderer->push(msg);
+                if (terminationRequested())
                     shouldQuit = true;
-                }
             }
-
-            // Look whether termination has been requested.
-            if (!from_renderer->empty())
+        }
+        catch (const netorcai::Error & e)
+        {
+            if (verbose)
             {
-                Message msg;
-                from_renderer->pop(msg);
+                printf("Failure: %s\n", e.what());
+                fflush(stdout);
+            }
 
-                if (msg.type == MessageType::TERMINATE)
+            if (persistent)
+            {
+                if (verbose)
                 {
-                    shouldQuit = true;
+                    printf("Waiting for the next netorcai game...\n"); fflush(stdout);
                 }
+                verbose = false;
+            }
+            else
+            {
+                forwardError(e.what());
+                shouldQuit = true;
             }
         }
-    }
-    catch (const netorcai::Error & e)
-    {
-        printf("Failure: %s\n", e.what());
 
-        // Forward ERROR to renderer.
-        Message msg;
-        msg.type = MessageType::ERROR;
-        asprintf((char**)&msg.data, "%s", e.what());
-        to_renderer->push(msg);
+        // In a session, wait a little for the next netorcai instance, then reconnect.
+        // Termination requests are still checked meanwhile.
+        for (int i = 0; persistent && !shouldQuit && i < sessionRetryDelayMs / 10; i++)
+        {
+            sf::sleep(sf::milliseconds(10));
+            shouldQuit = terminationRequested();
+        }
     }
+
+    relay(MessageType::TERMINATE, nullptr);
 }
 
-void renderer_thread_function(boost::lockfree::queue<Message> * from_network,
-    boost::lockfree::queue<Message> * to_network)
+/// What the renderer thread keeps about one netorcai game.
+struct RenderedGame
 {
-    sf::RenderWindow window(sf::VideoMode(800, 600), "hexabomb-visu");
-    window.setFramerateLimit(60);
+    explicit RenderedGame(const Assets & assets) : renderer(assets) {}
+
     HexabombRenderer renderer;
+    PlayoutBuffer playout; //!< Messages received but not shown yet. Not reset between games.
 
     std::unordered_map<Coordinates, Cell> cells;
     std::vector<Character> characters;
@@ -132,74 +332,421 @@ void renderer_thread_function(boost::lockfree::queue<Message> * from_network,
     int nbTurnsMax = -1;
 
     bool initialized = false;
+    int nbGamesPlayed = 0; //!< Number of GAME_STARTS received. Not reset between games.
+    int64_t turnReceivedMicroseconds = 0; //!< When the last turn not displayed yet was received, 0 if none.
 
+    /// Forget the current game. Buffers keep their memory for the next game.
+    void reset()
+    {
+        renderer.reset();
+        cells.clear();
+        characters.clear();
+        bombs.clear();
+        explosions.clear();
+        score.clear();
+        cellCount.clear();
+        nbTurnsMax = -1;
+        initialized = false;
+    }
+};
+
+/// Returns the window area (in viewport coordinates) of the index-th of nbTiles tiles.
+static sf::FloatRect tileArea(int index, int nbTiles)
+{
+    const int nbColumns = (int)ceil(sqrt(nbTiles));
+    const int nbRows = (nbTiles + nbColumns - 1) / nbColumns;
+
+    const float width = 1.f / nbColumns;
+    const float height = 1.f / nbRows;
+    return sf::FloatRect((index % nbColumns) * width, (index / nbColumns) * height, width, height);
+}
+
+void renderer_thread_function(const std::vector<boost::lockfree::queue<Message> *> & from_network,
+    const std::vector<boost::lockfree::queue<Message> *> & to_network,
+    const RendererOptions & options)
+{
+    const int nbGames = from_network.size();
+    const bool isDashboard = nbGames > 1;
+
+    sf::RenderWindow window(isDashboard ? sf::VideoMode(1280, 720) : sf::VideoMode(800, 600), "hexabomb-visu");
+
+    // Textures and font are loaded once and shared by all games.
+    // Images are decoded in the background while the window already shows the connection status.
+    Assets assets(options.searchAssets);
+    ThreadPool threadPool(options.nbThreads);
+    std::vector<std::unique_ptr<RenderedGame> > games;
+    for (int i = 0; i < nbGames; i++)
+    {
+        games.emplace_back(new RenderedGame(assets));
+        games[i]->renderer.setThreadPool(&threadPool);
+        games[i]->renderer.updateView(window.getSize().x, window.getSize().y, tileArea(i, nbGames));
+        games[i]->renderer.onStatusChange("connecting...");
+        games[i]->playout.setMaxDelay(options.playoutDelayMilliseconds * int64_t(1000));
+    }
+
+    // The software canvas replaces OpenGL drawing, or draws the exported frames.
+    // In software rendering, the canvas is shown as a texture that covers the window.
+    const bool useCanvas = options.softwareRendering || !options.framesDirectory.empty();
+    SoftwareCanvas canvas;
+    sf::Texture canvasTexture;
+    int nbFramesExported = 0;
+    int64_t lastFrameMicroseconds = 0;
+    auto resizeCanvas = [&](unsigned int width, unsigned int height)
+    {
+        canvas.create(width, height);
+        if (options.softwareRendering)
+            canvasTexture.create(width, height);
+    };
+    canvas.setThreadPool(&threadPool);
+    if (useCanvas)
+    {
+        // Texts are then drawn from a copy of the font textures, instead of reading them back at each draw.
+        assets.freezeFont(HexabombRenderer::characterSizes());
+        canvas.setFontImages(&assets);
+        resizeCanvas(window.getSize().x, window.getSize().y);
+    }
+
+    // Frames are only drawn when something changed, at most maxFramerate times per second.
+    // Window events cannot wake the thread up: They are polled at the frame rate for a while after
+    // the last change, so that input stays responsive, then at the idle rate.
+    // SFML does not report when the window must be repainted (e.g. uncovered), so idle windows are
+    // still redrawn once in a while.
+    const int64_t framePeriodMicroseconds = 1000000 / std::max(options.maxFramerate, 1);
+    const int64_t idleDelayMicroseconds = options.idleDelayMilliseconds * int64_t(1000);
+    const int64_t idlePollMicroseconds = 50000;
+    const int64_t idleRedrawMicroseconds = 1000000;
+    int64_t lastChangeMicroseconds = 0;
+    bool renderedLastIteration = false;
+
+#ifdef HEXABOMB_VISU_MJPEG
+    // Frames are only read back and encoded when they changed, and while someone watches.
+    std::unique_ptr<MjpegStream> stream;
+    if (options.mjpegPort != 0)
+        stream.reset(new MjpegStream(options.mjpegPort, 2, options.mjpegQuality));
+    FrameReadback readback;
+#endif
+
+    trace::setThreadName("renderer");
     while (window.isOpen())
     {
+        // Any window event redraws the window. Only messages, views and overlays change what is drawn.
+        bool changed = false;
+        bool boardChanged = false;
+
         // Check all the window's events that were triggered since the last iteration of the loop
+        trace::begin("pollEvent");
         sf::Event event;
         while (window.pollEvent(event))
         {
+            changed = true;
+
             // User wanted to close the window.
             if (event.type == sf::Event::Closed)
                 window.close();
             else if (event.type == sf::Event::Resized)
-                renderer.updateView(event.size.width, event.size.height);
+            {
+                boardChanged = true;
+                for (int i = 0; i < nbGames; i++)
+                    games[i]->renderer.updateView(event.size.width, event.size.height, tileArea(i, nbGames));
+                if (useCanvas)
+                    resizeCanvas(event.size.width, event.size.height);
+            }
             else if (event.type == sf::Event::KeyReleased)
             {
+                boardChanged = boardChanged || event.key.code == sf::Keyboard::C || event.key.code == sf::Keyboard::H
+                    || event.key.code == sf::Keyboard::B || event.key.code == sf::Keyboard::S;
                 if (event.key.code == sf::Keyboard::C)
-                    renderer.toggleShowCoordinates();
+                {
+                    for (auto & game : games)
+                        game->renderer.toggleShowCoordinates();
+                }
+                else if (event.key.code == sf::Keyboard::H)
+                {
+                    for (auto & game : games)
+                        game->renderer.cycleOverlay();
+                }
+                else if (event.key.code == sf::Keyboard::B)
+                {
+                    for (auto & game : games)
+                        game->renderer.toggleBombForecast();
+                }
+                else if (event.key.code == sf::Keyboard::S)
+                {
+                    for (auto & game : games)
+                        game->renderer.cycleChart();
+                }
+                else if (event.key.code == sf::Keyboard::T && !options.traceFilename.empty())
+                {
+                    if (trace::exportJSON(options.traceFilename))
+                        printf("Trace written to %s\n", options.traceFilename.c_str());
+                    else
+                        printf("Cannot write trace to %s\n", options.traceFilename.c_str());
+                    fflush(stdout);
+                }
             }
         }
+        trace::end("pollEvent");
 
         // Something has been received from the network?
-        if (!from_network->empty())
+        // Each game is updated at the pace of its own turns, smoothed by its playout buffer if any.
+        // Without playout buffer, messages are popped one frame at a time: The network thread then skips
+        // turns while the queue is not empty.
+        // Messages wait in their queue until all textures are ready.
+        const bool usePlayout = options.playoutDelayMilliseconds > 0;
+        bool received = false;
+        const int64_t receiveMicroseconds = monotonicMicroseconds();
+        for (int i = 0; i < nbGames && assets.poll(); i++)
         {
+            RenderedGame & game = *games[i];
+            HexabombRenderer & renderer = game.renderer;
+            GameMetrics & gameMetrics = metrics().game(i);
+
+            // The queue is emptied at once, so that the network thread does not skip turns the buffer can hold.
             Message msg;
-            from_network->pop(msg);
-            if (msg.type == MessageType::GAME_STARTS)
+            if (usePlayout)
             {
-                auto gameStarts = (GameStartsMessage *) msg.data;
-                parseGameState(gameStarts->initialGameState, cells, characters, bombs, explosions, score, cellCount);
-                nbTurnsMax = gameStarts->nbTurnsMax;
-                if (gameStarts->nbSpecialPlayers > 0)
-                    renderer.setSuddenDeath(true);
-                renderer.onGameInit(cells, characters, bombs, score, cellCount, nbTurnsMax, gameStarts->playersInfo);
-                delete gameStarts;
-                initialized = true;
+                trace::begin("pop");
+                while (from_network[i]->pop(msg))
+                {
+                    gameMetrics.messagesPopped.add();
+                    game.playout.push(msg);
+                }
+                trace::end("pop");
             }
-            else if (msg.type == MessageType::TURN)
+            auto popMessage = [&](bool & isOverdue)
             {
-                auto turn = (TurnMessage *) msg.data;
-                parseGameState(turn->gameState, cells, characters, bombs, explosions, score, cellCount);
-                renderer.onTurn(cells, characters, bombs, explosions, score, cellCount, turn->turnNumber+1, nbTurnsMax, turn->playersInfo);
-                delete turn;
-            }
-            else if (msg.type == MessageType::GAME_ENDS)
+                isOverdue = false;
+                if (usePlayout)
+                    return game.playout.pop(msg, receiveMicroseconds, isOverdue);
+                if (!from_network[i]->pop(msg))
+                    return false;
+                gameMetrics.messagesPopped.add();
+                return true;
+            };
+
+            // Digests of skipped turns and overdue turns are applied at once: Only the next message is shown in this frame.
+            bool isOverdue = false;
+            for (bool isShown = false; !isShown && popMessage(isOverdue); )
             {
-                auto gameEnds = (GameEndsMessage *) msg.data;
-                parseGameState(gameEnds->gameState, cells, characters, bombs, explosions, score, cellCount);
-                renderer.onStatusChange("game over");
-                renderer.onTurn(cells, characters, bombs, explosions, score, cellCount, nbTurnsMax, nbTurnsMax);
-                delete gameEnds;
+                isShown = msg.type != MessageType::SKIPPED_TURN && !isOverdue;
+                received = received || isShown;
+                boardChanged = true;
+                if (msg.type == MessageType::TURN && isOverdue)
+                {
+                    // A newer turn is due: This one only feeds the statistics and heatmaps.
+                    auto turn = (TurnMessage *) msg.data;
+                    parseGameState(turn->gameState, game.cells, game.characters, game.bombs, game.explosions, game.score, game.cellCount);
+                    renderer.onSkippedTurn(game.cells, game.characters, game.bombs, game.explosions, game.score, game.cellCount, turn->turnNumber+1);
+                    gameMetrics.turnNumber.set(turn->turnNumber+1);
+                    gameMetrics.playoutDropped.add();
+                    turn_message_pool().release(turn);
+                }
+                else if (msg.type == MessageType::GAME_STARTS)
+                {
+                    auto gameStarts = (GameStartsMessage *) msg.data;
+                    if (game.initialized)
+                        game.reset();
+                    parseGameState(gameStarts->initialGameState, game.cells, game.characters, game.bombs, game.explosions, game.score, game.cellCount);
+                    game.nbTurnsMax = gameStarts->nbTurnsMax;
+                    if (gameStarts->nbSpecialPlayers > 0)
+                        renderer.setSuddenDeath(true);
+                    renderer.onGameInit(game.cells, game.characters, game.bombs, game.score, game.cellCount, game.nbTurnsMax, gameStarts->playersInfo);
+                    delete gameStarts;
+                    game.initialized = true;
+                    game.nbGamesPlayed++;
+                    gameMetrics.gameNumber.set(game.nbGamesPlayed);
+                    gameMetrics.turnNumber.set(0);
+                }
+                else if (msg.type == MessageType::TURN)
+                {
+                    auto turn = (TurnMessage *) msg.data;
+                    if (usePlayout)
+                        gameMetrics.playoutDelay.observe(game.playout.lastDelayMicroseconds());
+
+                    // Parsing and onTurn delay the next frame: Only the vertices are built in the background.
+                    trace::begin("parseGameState");
+                    parseGameState(turn->gameState, game.cells, game.characters, game.bombs, game.explosions, game.score, game.cellCount);
+                    trace::end("parseGameState");
+                    trace::begin("onTurn");
+                    renderer.onTurn(game.cells, game.characters, game.bombs, game.explosions, game.score, game.cellCount, turn->turnNumber+1, game.nbTurnsMax, turn->playersInfo);
+                    trace::end("onTurn");
+                    gameMetrics.turnNumber.set(turn->turnNumber+1);
+                    game.turnReceivedMicroseconds = msg.receivedMicroseconds;
+                    turn_message_pool().release(turn);
+                }
+                else if (msg.type == MessageType::GAME_ENDS)
+                {
+                    auto gameEnds = (GameEndsMessage *) msg.data;
+                    parseGameState(gameEnds->gameState, game.cells, game.characters, game.bombs, game.explosions, game.score, game.cellCount);
+                    renderer.onStatusChange("game over");
+                    renderer.onTurn(game.cells, game.characters, game.bombs, game.explosions, game.score, game.cellCount, game.nbTurnsMax, game.nbTurnsMax);
+                    delete gameEnds;
+
+                    if (!options.statsFilename.empty())
+                    {
+                        const std::string filename = numberedFilename(options.statsFilename, i, nbGames,
+                            options.session ? game.nbGamesPlayed : 0);
+                        if (renderer.stats().exportCSV(filename))
+                            printf("Statistics written to %s\n", filename.c_str());
+                        else
+                            printf("Cannot write statistics to %s\n", filename.c_str());
+                        fflush(stdout);
+                    }
+
+                    // Memory should stay flat from one game to the next.
+                    size_t buffersBytes = 0;
+                    for (const auto & g : games)
+                        buffersBytes += g->renderer.memoryUsage();
+                    printf("Memory: %zu KiB resident, %zu KiB of game buffers\n",
+                        residentMemoryBytes() / 1024, buffersBytes / 1024);
+                    fflush(stdout);
+                }
+                else if (msg.type == MessageType::SKIPPED_TURN)
+                {
+                    auto digest = (TurnDigest *) msg.data;
+                    renderer.onSkippedTurn(*digest);
+                    delete digest;
+                }
+                else if (msg.type == MessageType::ERROR)
+                {
+                    // A single game that could not start closes the window.
+                    // In a dashboard, the other games are still worth watching.
+                    if (!game.initialized && !isDashboard)
+                        window.close();
+                    else
+                        renderer.onStatusChange(std::string((char *) msg.data));
+                    free((char *) msg.data);
+                }
             }
-            else if (msg.type == MessageType::ERROR)
+            gameMetrics.playoutDepth.set(game.playout.depth());
+        }
+
+        // Frames drawn while board jobs run may show their result.
+        int64_t nextReleaseMicroseconds = std::numeric_limits<int64_t>::max();
+        for (const auto & game : games)
+        {
+            boardChanged = boardChanged || game->renderer.isUpdating();
+            nextReleaseMicroseconds = std::min(nextReleaseMicroseconds, game->playout.nextReleaseMicroseconds());
+        }
+#ifdef HEXABOMB_VISU_MJPEG
+        if (stream != nullptr && stream->takeFrameRequest())
+            boardChanged = true;
+#endif
+        changed = changed || boardChanged || !assets.isReady();
+
+        // Nothing new to show: Keep the last frame, and sleep until a message arrives or events must be polled.
+        int64_t nowMicroseconds = monotonicMicroseconds();
+        if (changed)
+            lastChangeMicroseconds = nowMicroseconds;
+        const bool isIdle = nowMicroseconds - lastChangeMicroseconds >= idleDelayMicroseconds;
+        if (!changed && (!isIdle || nowMicroseconds - lastFrameMicroseconds < idleRedrawMicroseconds))
+        {
+#ifdef HEXABOMB_VISU_MJPEG
+            // No frame follows for a while: The frames still on the GPU are read back now.
+            if (stream != nullptr)
             {
-                if (!initialized)
-                    window.close();
-                else
-                    renderer.onStatusChange(std::string((char *) msg.data));
-                free((char *) msg.data);
+                while (const sf::Image * frame = readback.collect(true))
+                    stream->publish(*frame);
             }
+#endif
+            // Buffered turns wake the loop up when they are due.
+            int64_t waitMicroseconds = isIdle ? idlePollMicroseconds : framePeriodMicroseconds;
+            if (nextReleaseMicroseconds != std::numeric_limits<int64_t>::max())
+                waitMicroseconds = std::min(waitMicroseconds, std::max<int64_t>(0, nextReleaseMicroseconds - nowMicroseconds));
+            trace::begin("wait");
+            renderer_wakeup().waitFor(waitMicroseconds);
+            trace::end("wait");
+            renderedLastIteration = false;
+            continue;
+        }
+
+        // Keep frames at least one period apart. A frame that follows a wait is drawn at once.
+        if (nowMicroseconds - lastFrameMicroseconds < framePeriodMicroseconds)
+        {
+            sf::sleep(sf::microseconds(framePeriodMicroseconds - (nowMicroseconds - lastFrameMicroseconds)));
+            nowMicroseconds = monotonicMicroseconds();
         }
 
         // Render on the window
-        renderer.render(window);
+        trace::begin("render");
+        if (useCanvas && (options.softwareRendering || received))
+        {
+            canvas.clear(sf::Color::Black);
+            for (auto & game : games)
+                game->renderer.draw(canvas);
+        }
+
+        window.clear(sf::Color::Black);
+        if (options.softwareRendering)
+        {
+            canvasTexture.update(canvas.getPixelsPtr());
+            window.setView(sf::View(sf::FloatRect(0.f, 0.f, window.getSize().x, window.getSize().y)));
+            window.draw(sf::Sprite(canvasTexture));
+        }
+        else
+        {
+            for (auto & game : games)
+                game->renderer.draw(window);
+        }
+        trace::end("render");
+
+#ifdef HEXABOMB_VISU_MJPEG
+        // Other window events, e.g. mouse moves, redraw the window, but do not change the stream.
+        if (stream != nullptr && stream->hasClients() && boardChanged)
+        {
+            trace::Scope scope("stream");
+            if (options.softwareRendering)
+                stream->publish(canvas.getPixelsPtr(), canvas.getSize().x, canvas.getSize().y);
+            else
+            {
+                if (const sf::Image * frame = readback.collect(false))
+                    stream->publish(*frame);
+                readback.capture(window);
+            }
+        }
+        else if (stream != nullptr && !stream->hasClients())
+            readback.clear();
+#endif
+
+        trace::begin("display");
+        window.display();
+        trace::end("display");
+
+        // Only frames drawn back to back are timed: Idle gaps are not frame times.
+        const int64_t frameMicroseconds = monotonicMicroseconds();
+        if (renderedLastIteration)
+            metrics().frameTime.observe(frameMicroseconds - lastFrameMicroseconds);
+        lastFrameMicroseconds = frameMicroseconds;
+        renderedLastIteration = true;
+        for (int i = 0; i < nbGames; i++)
+        {
+            if (games[i]->turnReceivedMicroseconds > 0)
+                metrics().game(i).turnDisplayLatency.observe(frameMicroseconds - games[i]->turnReceivedMicroseconds);
+            games[i]->turnReceivedMicroseconds = 0;
+        }
+
+        if (!options.framesDirectory.empty() && received)
+        {
+            char filename[32];
+            snprintf(filename, sizeof(filename), "/frame-%06d.png", nbFramesExported++);
+            if (!canvas.saveToFile(options.framesDirectory + filename))
+            {
+                printf("Cannot write frame to %s%s\n", options.framesDirectory.c_str(), filename);
+                fflush(stdout);
+            }
+        }
     }
 
-    // Window closed. Ask the network to terminate gently.
-    Message msg;
-    msg.type = MessageType::TERMINATE;
-    to_network->push(msg);
+    for (auto & game : games)
+        game->playout.clear();
+
+    // Window closed. Ask the networks to terminate gently.
+    for (auto * queue : to_network)
+    {
+        Message msg;
+        msg.type = MessageType::TERMINATE;
+        queue->push(msg);
+    }
 }
 
 void flush_queues(boost::lockfree::queue<Message> * to_network,
@@ -209,14 +756,21 @@ void flush_queues(boost::lockfree::queue<Message> * to_network,
     while (to_network->pop(msg));
 
     while (to_renderer->pop(msg))
-    {
-        if (msg.type == MessageType::GAME_STARTS)
-            delete (GameStartsMessage*) msg.data;
-        else if (msg.type == MessageType::TURN)
-            delete (TurnMessage*) msg.data;
-        else if (msg.type == MessageType::GAME_ENDS)
-            delete (GameEndsMessage*) msg.data;
-        else if (msg.type == MessageType::ERROR)
-            free((char*) msg.data);
-    }
+        delete_message_data(msg);
+}
+
+void delete_message_data(Message & msg)
+{
+    if (msg.type == MessageType::GAME_STARTS)
+        delete (GameStartsMessage*) msg.data;
+    else if (msg.type == MessageType::TURN)
+        turn_message_pool().release((TurnMessage*) msg.data);
+    else if (msg.type == MessageType::GAME_ENDS)
+        delete (GameEndsMessage*) msg.data;
+    else if (msg.type == MessageType::SKIPPED_TURN)
+        delete (TurnDigest*) msg.data;
+    else if (msg.type == MessageType::ERROR)
+        free((char*) msg.data);
+
+    msg.data = nullptr;
 }
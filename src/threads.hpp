@@ -1,13 +1,22 @@
 #pragma once
 
+#include <string>
+#include <vector>
+
 #include <boost/lockfree/queue.hpp>
 
+#include <netorcai-client-cpp/message.hpp>
+
+#include "object-pool.hpp"
+#include "wakeup.hpp"
+
 enum class MessageType
 {
     // From Network to Renderer
     GAME_STARTS,
     GAME_ENDS,
     TURN,
+    SKIPPED_TURN, //!< The TurnDigest of a turn that was not forwarded.
     ERROR,
 
     // From Renderer to Network
@@ -18,14 +27,74 @@ struct Message
 {
     MessageType type;
     void * data = nullptr;
+    int64_t receivedMicroseconds = 0; //!< When the network thread received the message (see monotonicMicroseconds).
 };
 
+struct GameMetrics;
+
+/**
+ * @brief Receive a game from netorcai
+ * @param from_renderer Requests from the renderer (TERMINATE)
+ * @param to_renderer The received messages. Turns are skipped if the renderer is late: Only their digest is sent.
+ * @param hostname The netorcai hostname
+ * @param port The netorcai TCP port
+ * @param to_relay If not null, a copy of every received message is sent there (see relay_thread_function).
+ *        A TERMINATE message is sent there when the thread ends.
+ * @param recordFilename If not empty, the received GAME_STARTS, TURN and GAME_ENDS messages are appended
+ *        to this game log (see GameLogWriter).
+ * @param persistent Whether games are received one after the other (session) until TERMINATE.
+ *        After GAME_ENDS, or if netorcai cannot be reached, the thread reconnects for the next game
+ *        instead of ending. Errors are then not forwarded to the renderer.
+ * @param gameMetrics The metrics of the game, whose network counters are updated by this thread.
+ */
 void network_thread_function(boost::lockfree::queue<Message> * from_renderer,
     boost::lockfree::queue<Message> * to_renderer,
-    const std::string & hostname, uint16_t port);
+    const std::string & hostname, uint16_t port,
+    boost::lockfree::queue<Message> * to_relay,
+    const std::string & recordFilename,
+    bool persistent,
+    GameMetrics * gameMetrics);
+
+/// Options of the renderer thread.
+struct RendererOptions
+{
+    std::string statsFilename; //!< If not empty, per-turn statistics are exported there as CSV at GAME_ENDS.
+    bool searchAssets = false; //!< Whether assets are searched on the filesystem even if they are embedded.
+    int nbThreads = 0; //!< Number of worker threads that update large boards. 0 updates them on the renderer thread.
+    bool session = false; //!< Whether games follow one another. Statistics files are then numbered by game.
+    bool softwareRendering = false; //!< Whether games are drawn by the CPU (see SoftwareCanvas) instead of OpenGL.
+    std::string framesDirectory; //!< If not empty, the window is saved there as a PNG image after each received message.
+    std::string traceFilename; //!< If not empty, the trace (see trace.hpp) is written there when T is pressed.
+    int maxFramerate = 60; //!< Frames per second while something changes on screen.
+    int idleDelayMilliseconds = 500; //!< Time without any change after which the window stops redrawing.
+    int playoutDelayMilliseconds = 0; //!< The longest time turns are held to be shown at a steady pace (see PlayoutBuffer). 0 disables the buffer.
+    uint16_t mjpegPort = 0; //!< If not 0, frames that changed are streamed there (see MjpegStream). Needs -Dmjpeg_stream.
+    int mjpegQuality = 80; //!< JPEG quality of the streamed frames, from 1 to 100.
+};
+
+/**
+ * @brief Render netorcai games into one window
+ * @param from_network The queue from the network thread of each game
+ * @param to_network The queue to the network thread of each game
+ * @param options The renderer options
+ * @details With several games, the window is split into one tile per game (dashboard).
+ *          The metrics of the index-th game are metrics().game(index).
+ *          Frames are drawn at maxFramerate while messages, input or board updates keep coming.
+ *          When nothing changed for idleDelayMilliseconds, the last frame stays on screen and the thread
+ *          sleeps on renderer_wakeup(), only polling window events at a low rate.
+ */
+void renderer_thread_function(const std::vector<boost::lockfree::queue<Message> *> & from_network,
+    const std::vector<boost::lockfree::queue<Message> *> & to_network,
+    const RendererOptions & options);
+
+/// Woken by network threads whenever they push a message to the renderer.
+Wakeup & renderer_wakeup();
+
+/// The TurnMessage objects exchanged between threads. Acquired by senders, released by receivers.
+ObjectPool<netorcai::TurnMessage> & turn_message_pool();
 
-void renderer_thread_function(boost::lockfree::queue<Message> * from_network,
-    boost::lockfree::queue<Message> * to_network);
+/// Release the data owned by a message.
+void delete_message_data(Message & msg);
 
 void flush_queues(boost::lockfree::queue<Message> * to_network,
     boost::lockfree::queue<Message> * to_renderer);
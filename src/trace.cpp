@@ -0,0 +1,182 @@
+#include "trace.hpp"
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "util.hpp"
+
+namespace trace
+{
+
+/// One begin or end event. Fields are atomics, as the exporter may read them while they are written.
+struct Event
+{
+    std::atomic<const char *> name{nullptr};
+    std::atomic<int64_t> timestamp{0}; //!< In microseconds (see monotonicMicroseconds).
+    std::atomic<bool> isBegin{false};
+};
+
+/// The events of one thread. Only this thread writes them.
+struct ThreadBuffer
+{
+    static const uint64_t capacity = 1 << 16;
+
+    ~ThreadBuffer() { delete[] events.load(); }
+
+    std::string threadName;
+    int threadID = 0;
+    std::atomic<Event *> events{nullptr}; //!< Allocated at the first recorded event, so that untraced threads cost nothing.
+    std::atomic<uint64_t> nbEvents{0}; //!< Number of events recorded so far. The last capacity ones are kept.
+};
+
+/// An event copied out of a ring, for export.
+struct EventCopy
+{
+    const char * name;
+    int64_t timestamp;
+    bool isBegin;
+};
+
+/// The events of one thread, copied out of its ring, for export.
+struct ThreadSnapshot
+{
+    std::string threadName;
+    int threadID;
+    std::vector<EventCopy> events;
+};
+
+static std::atomic<bool> enabled{false};
+static std::mutex buffersMutex; //!< Only taken when a thread is registered or named, and to copy the events for export.
+static std::vector<std::unique_ptr<ThreadBuffer> > buffers; //!< Kept until exit, so that ended threads are exported too.
+static thread_local ThreadBuffer * threadBuffer = nullptr;
+
+static ThreadBuffer & buffer()
+{
+    if (threadBuffer == nullptr)
+    {
+        std::lock_guard<std::mutex> lock(buffersMutex);
+        buffers.emplace_back(new ThreadBuffer);
+        threadBuffer = buffers.back().get();
+        threadBuffer->threadID = buffers.size();
+        threadBuffer->threadName = "thread " + std::to_string(threadBuffer->threadID);
+    }
+    return *threadBuffer;
+}
+
+void record(const char * name, bool isBegin)
+{
+    ThreadBuffer & b = buffer();
+    Event * events = b.events.load(std::memory_order_relaxed);
+    if (events == nullptr)
+    {
+        events = new Event[ThreadBuffer::capacity];
+        b.events.store(events, std::memory_order_release);
+    }
+
+    const uint64_t index = b.nbEvents.load(std::memory_order_relaxed);
+    Event & event = events[index % ThreadBuffer::capacity];
+    event.name.store(name, std::memory_order_relaxed);
+    event.timestamp.store(monotonicMicroseconds(), std::memory_order_relaxed);
+    event.isBegin.store(isBegin, std::memory_order_relaxed);
+    b.nbEvents.store(index + 1, std::memory_order_release);
+}
+
+void setEnabled(bool isEnabled)
+{
+    enabled.store(isEnabled, std::memory_order_relaxed);
+}
+
+bool isEnabled()
+{
+    return enabled.load(std::memory_order_relaxed);
+}
+
+void setThreadName(const std::string & name)
+{
+    // Registering the thread does not allocate its ring: Naming threads is free when tracing is disabled.
+    ThreadBuffer & b = buffer();
+    std::lock_guard<std::mutex> lock(buffersMutex);
+    b.threadName = name;
+}
+
+/// Copy the events of a thread that are still in its ring.
+static void copyEvents(const ThreadBuffer & b, std::vector<EventCopy> & copies)
+{
+    // nbEvents is read first: The ring is allocated before any event is counted, so it is set if nbEvents > 0.
+    const uint64_t nbEvents = b.nbEvents.load(std::memory_order_acquire);
+    const Event * ring = b.events.load(std::memory_order_acquire);
+    if (ring == nullptr)
+        return;
+
+    // Events older than the ring are lost. Those overwritten while reading are detected afterwards.
+    const uint64_t oldest = nbEvents > ThreadBuffer::capacity ? nbEvents - ThreadBuffer::capacity : 0;
+    std::vector<EventCopy> events;
+    events.reserve(nbEvents - oldest);
+    for (uint64_t i = oldest; i < nbEvents; i++)
+    {
+        const Event & event = ring[i % ThreadBuffer::capacity];
+        events.push_back(EventCopy{event.name.load(std::memory_order_relaxed),
+            event.timestamp.load(std::memory_order_relaxed), event.isBegin.load(std::memory_order_relaxed)});
+    }
+    const uint64_t nbEventsAfter = b.nbEvents.load(std::memory_order_acquire);
+    const uint64_t firstValid = nbEventsAfter > ThreadBuffer::capacity ? nbEventsAfter - ThreadBuffer::capacity : 0;
+
+    // Ends whose begin has been lost are skipped, so that the viewer nests the remaining events correctly.
+    const uint64_t first = std::max(oldest, firstValid);
+    int depth = 0;
+    copies.reserve(nbEvents > first ? nbEvents - first : 0);
+    for (uint64_t i = first; i < nbEvents; i++)
+    {
+        const EventCopy & event = events[i - oldest];
+        if (!event.isBegin && depth == 0)
+            continue;
+        depth += event.isBegin ? 1 : -1;
+        copies.push_back(event);
+    }
+}
+
+bool exportJSON(const std::string & filename)
+{
+    // Events are copied under the lock, and written without it.
+    std::vector<ThreadSnapshot> snapshots;
+    {
+        std::lock_guard<std::mutex> lock(buffersMutex);
+        snapshots.resize(buffers.size());
+        for (unsigned int i = 0; i < buffers.size(); i++)
+        {
+            snapshots[i].threadName = buffers[i]->threadName;
+            snapshots[i].threadID = buffers[i]->threadID;
+            copyEvents(*buffers[i], snapshots[i].events);
+        }
+    }
+
+    FILE * file = fopen(filename.c_str(), "w");
+    if (file == nullptr)
+        return false;
+
+    fprintf(file, "{\"traceEvents\":[\n");
+    bool first = true;
+    for (const auto & snapshot : snapshots)
+    {
+        fprintf(file, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":\"%s\"}}",
+            first ? "" : ",\n", snapshot.threadID, snapshot.threadName.c_str());
+        first = false;
+
+        for (const auto & event : snapshot.events)
+        {
+            fprintf(file, ",\n{\"name\":\"%s\",\"ph\":\"%s\",\"ts\":%lld,\"pid\":1,\"tid\":%d}",
+                event.name, event.isBegin ? "B" : "E", (long long) event.timestamp, snapshot.threadID);
+        }
+    }
+    fprintf(file, "\n]}\n");
+
+    return fclose(file) == 0;
+}
+
+}
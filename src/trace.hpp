@@ -0,0 +1,58 @@
+#pragma once
+
+#include <string>
+
+/**
+ * @brief Low-overhead timeline of what each thread does, exported in Chrome trace-event format
+ * @details Each thread records begin/end events into its own ring buffer, without locks.
+ *          Only the last events of each thread are kept. Tracing is disabled by default,
+ *          and a disabled scope costs one relaxed atomic load.
+ *          The exported JSON file opens in chrome://tracing or https://ui.perfetto.dev.
+ */
+namespace trace
+{
+    /// Enable or disable tracing. Must be called before the traced threads start.
+    void setEnabled(bool enabled);
+    bool isEnabled();
+
+    /// Name the calling thread in the exported timeline. Cheap: The ring buffer is only allocated at the first event.
+    void setThreadName(const std::string & name);
+
+    void record(const char * name, bool isBegin);
+
+    /// Record the beginning of an event on the calling thread. name must be a string literal.
+    inline void begin(const char * name)
+    {
+        if (isEnabled())
+            record(name, true);
+    }
+
+    /// Record the end of the last event begun on the calling thread.
+    inline void end(const char * name)
+    {
+        if (isEnabled())
+            record(name, false);
+    }
+
+    /**
+     * @brief Write the events of all threads as Chrome trace-event JSON
+     * @details May be called while other threads record events. Events being overwritten meanwhile are skipped.
+     *          The events are copied first, so that writing the file does not block other threads.
+     * @return Whether the file has been written
+     */
+    bool exportJSON(const std::string & filename);
+
+    /// Record an event for the lifetime of the scope.
+    class Scope
+    {
+    public:
+        explicit Scope(const char * name) : _name(name) { begin(_name); }
+        ~Scope() { end(_name); }
+
+        Scope(const Scope &) = delete;
+        Scope & operator=(const Scope &) = delete;
+
+    private:
+        const char * _name;
+    };
+}
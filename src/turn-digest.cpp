@@ -0,0 +1,34 @@
+#include "turn-digest.hpp"
+
+void TurnDigester::reset(const netorcai::json & initialGameState)
+{
+    _cells.clear();
+    track(initialGameState);
+}
+
+void TurnDigester::track(const netorcai::json & gameState)
+{
+    for (const auto & jsonCell : gameState["cells"])
+    {
+        const Coordinates coord{jsonCell["q"].get<int>(), jsonCell["r"].get<int>()};
+        _cells[coord] = Cell{coord, jsonCell["color"].get<int>()};
+    }
+}
+
+TurnDigest * TurnDigester::digest(int turnNumber, const netorcai::json & gameState)
+{
+    auto digest = new TurnDigest;
+    digest->turnNumber = turnNumber;
+
+    for (const auto & jsonCell : gameState["cells"])
+    {
+        const Coordinates coord{jsonCell["q"].get<int>(), jsonCell["r"].get<int>()};
+        const int color = jsonCell["color"];
+        auto it = _cells.find(coord);
+        if (it == _cells.end() || it->second.color != color)
+            digest->changedCells.push_back(Cell{coord, color});
+    }
+
+    parseGameState(gameState, _cells, digest->characters, digest->bombs, digest->explosions, digest->score, digest->cellCount);
+    return digest;
+}
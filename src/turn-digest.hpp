@@ -0,0 +1,47 @@
+#pragma once
+
+#include <map>
+#include <unordered_map>
+#include <vector>
+
+#include <netorcai-client-cpp/message.hpp>
+
+#include "hexabomb-parse.hpp"
+
+/**
+ * @brief What the statistics and heatmaps need from a turn that is not displayed
+ * @details Network threads skip turns when the renderer is late. The digest of each skipped turn
+ *          is sent instead (see MessageType::SKIPPED_TURN). It is much smaller than the game state,
+ *          so that statistics and heatmaps cover every turn without flooding the renderer.
+ */
+struct TurnDigest
+{
+    int turnNumber = 0; //!< As in the TURN message.
+    std::vector<Cell> changedCells; //!< The cells whose color changed since the previous turn.
+    std::vector<Character> characters;
+    std::vector<Bomb> bombs;
+    std::unordered_map<int, std::vector<Coordinates> > explosions;
+    std::map<int, int> score;
+    std::map<int, int> cellCount;
+};
+
+/**
+ * @brief Builds the digests of turns
+ * @details Cell changes are found by comparing with the previous turn: The digester must see every
+ *          turn of a game, whether it is digested or forwarded.
+ */
+class TurnDigester
+{
+public:
+    /// Start a new game.
+    void reset(const netorcai::json & initialGameState);
+
+    /// Follow a turn that is forwarded to the renderer.
+    void track(const netorcai::json & gameState);
+
+    /// Digest a turn into a new TurnDigest, owned by the caller.
+    TurnDigest * digest(int turnNumber, const netorcai::json & gameState);
+
+private:
+    std::unordered_map<Coordinates, Cell> _cells; //!< The cells as of the last turn seen.
+};
@@ -2,6 +2,7 @@
 
 #include <stdio.h>
 
+#include <chrono>
 #include <stdexcept>
 
 #include <boost/algorithm/string/join.hpp>
@@ -32,7 +33,11 @@ static std::string searchAbsoluteFilename(const std::string & filename,
         boost::algorithm::join(searchedPathsStrings, "\n"));
 }
 
-std::string searchImageAbsoluteFilename(const std::string & filename)
+/**
+ * @brief Build the predefined search paths of an asset kind
+ * @param assetDir The asset directory in the git repo (e.g., "img")
+ */
+static std::vector<fs::path> assetSearchPaths(const std::string & assetDir)
 {
     // Convenient variables
     fs::path programPath(programAbsoluteFilename());
@@ -40,31 +45,24 @@ std::string searchImageAbsoluteFilename(const std::string & filename)
     fs::path currentDirPath = fs::current_path();
 
     // Predefined search paths
-    std::vector<fs::path> searchedPaths = {
+    return {
         fs::path(programDirPath.string() + "/../share/hexabomb-visu/"), // Assets/program in installed hexabomb-visu.
-        fs::path(programDirPath.string() + "/../assets/img/"), // Assets in git repo. Program in meson build directory.
-        fs::path(currentDirPath.string() + "/assets/img/"), // Run from the git repo root.
+        fs::path(programDirPath.string() + "/../assets/" + assetDir + "/"), // Assets in git repo. Program in meson build directory.
+        fs::path(currentDirPath.string() + "/assets/" + assetDir + "/"), // Run from the git repo root.
         fs::path(currentDirPath.string() + "/") // Assets are in current directory.
     };
+}
 
+std::string searchImageAbsoluteFilename(const std::string & filename)
+{
+    // Search paths are only computed once (this reads /proc).
+    static const std::vector<fs::path> searchedPaths = assetSearchPaths("img");
     return searchAbsoluteFilename(filename, searchedPaths);
 }
 
 std::string searchFontAbsoluteFilename(const std::string & filename)
 {
-    // Convenient variables
-    fs::path programPath(programAbsoluteFilename());
-    fs::path programDirPath(programPath.parent_path());
-    fs::path currentDirPath = fs::current_path();
-
-    // Predefined search paths
-    std::vector<fs::path> searchedPaths = {
-        fs::path(programDirPath.string() + "/../share/hexabomb-visu/"), // Assets/program in installed hexabomb-visu.
-        fs::path(programDirPath.string() + "/../assets/fonts/"), // Assets in git repo. Program in meson build directory.
-        fs::path(currentDirPath.string() + "/assets/fonts/"), // Run from the git repo root.
-        fs::path(currentDirPath.string() + "/") // Assets are in current directory.
-    };
-
+    static const std::vector<fs::path> searchedPaths = assetSearchPaths("fonts");
     return searchAbsoluteFilename(filename, searchedPaths);
 }
 
@@ -90,3 +88,45 @@ std::string programAbsoluteFilename()
     #error Unsupported system: Does not know how to get program absolute filename
 #endif
 }
+
+size_t residentMemoryBytes()
+{
+#ifdef __linux__
+    // Second field of statm: resident set size, in pages.
+    FILE * statm = fopen("/proc/self/statm", "r");
+    if (statm == nullptr)
+        return 0;
+
+    unsigned long size = 0, resident = 0;
+    const int nbRead = fscanf(statm, "%lu %lu", &size, &resident);
+    fclose(statm);
+    if (nbRead != 2)
+        return 0;
+    return resident * sysconf(_SC_PAGESIZE);
+#else
+    return 0;
+#endif
+}
+
+int64_t monotonicMicroseconds()
+{
+    using namespace std::chrono;
+    return duration_cast<microseconds>(steady_clock::now().time_since_epoch()).count();
+}
+
+std::string numberedFilename(const std::string & filename, int index, int nbGames, int gameNumber)
+{
+    // stats.csv -> stats-1.csv (dashboard), stats-7.csv (session), stats-1-7.csv (both)
+    std::string suffix;
+    if (nbGames > 1)
+        suffix += "-" + std::to_string(index + 1);
+    if (gameNumber > 0)
+        suffix += "-" + std::to_string(gameNumber);
+    if (suffix.empty())
+        return filename;
+
+    const size_t dot = filename.rfind('.');
+    if (dot == std::string::npos || filename.find('/', dot) != std::string::npos)
+        return filename + suffix;
+    return filename.substr(0, dot) + suffix + filename.substr(dot);
+}
@@ -1,5 +1,8 @@
 #pragma once
 
+#include <stddef.h>
+#include <stdint.h>
+
 #include <string>
 
 /**
@@ -17,3 +20,18 @@ std::string searchImageAbsoluteFilename(const std::string & filename);
 std::string searchFontAbsoluteFilename(const std::string & filename);
 
 std::string programAbsoluteFilename();
+
+/// The resident memory of the process in bytes, or 0 if it cannot be read on this system.
+size_t residentMemoryBytes();
+
+/// A monotonic clock in microseconds, comparable between threads. Its origin is unspecified.
+int64_t monotonicMicroseconds();
+
+/**
+ * @brief Returns the filename of an output file that exists once per game
+ * @param filename The filename given by the user
+ * @param index The index of the game among the nbGames watched games
+ * @param nbGames The number of watched games
+ * @param gameNumber The number of the game in a session (from 1), or 0 for one file for all games
+ */
+std::string numberedFilename(const std::string & filename, int index, int nbGames, int gameNumber);
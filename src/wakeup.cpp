@@ -0,0 +1,23 @@
+#include "wakeup.hpp"
+
+#include <chrono>
+
+void Wakeup::notify()
+{
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _notified = true;
+    }
+    _condition.notify_one();
+}
+
+bool Wakeup::waitFor(int64_t microseconds)
+{
+    std::unique_lock<std::mutex> lock(_mutex);
+    if (microseconds > 0)
+        _condition.wait_for(lock, std::chrono::microseconds(microseconds), [this]() { return _notified; });
+
+    const bool notified = _notified;
+    _notified = false;
+    return notified;
+}
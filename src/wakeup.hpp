@@ -0,0 +1,29 @@
+#pragma once
+
+#include <stdint.h>
+
+#include <condition_variable>
+#include <mutex>
+
+/**
+ * @brief Lets a thread sleep until another one has something for it, or until a deadline
+ * @details Notifications are remembered: A notify() that happens before waitFor() makes it return at once,
+ *          so that a message pushed just before the wait is not missed. Several notifications count as one.
+ */
+class Wakeup
+{
+public:
+    /// Wake the waiting thread, or the next one to wait.
+    void notify();
+
+    /**
+     * @brief Sleep until notified, or for at most microseconds
+     * @return Whether a notification was received. It is consumed.
+     */
+    bool waitFor(int64_t microseconds);
+
+private:
+    std::mutex _mutex;
+    std::condition_variable _condition;
+    bool _notified = false;
+};
@@ -0,0 +1,63 @@
+#!/usr/bin/env python3
+"""Generate a C++ source file that embeds asset files as constant byte arrays.
+
+Usage: embed-assets.py OUTPUT.cpp ASSET_FILE...
+
+Assets are looked up by basename with findEmbeddedAsset (see src/embedded-assets.hpp).
+"""
+import os
+import sys
+
+
+def main():
+    if len(sys.argv) < 2:
+        print(__doc__, file=sys.stderr)
+        return 1
+
+    output_filename = sys.argv[1]
+    input_filenames = sys.argv[2:]
+
+    lines = [
+        '// Generated by tools/embed-assets.py. Do not edit.',
+        '#include "embedded-assets.hpp"',
+        '',
+        '#include <string.h>',
+        '',
+    ]
+
+    for i, filename in enumerate(input_filenames):
+        with open(filename, 'rb') as f:
+            data = f.read()
+
+        lines.append('static const unsigned char asset_{}[] = {{'.format(i))
+        for offset in range(0, len(data), 16):
+            chunk = data[offset:offset + 16]
+            lines.append('    ' + ','.join('0x{:02x}'.format(b) for b in chunk) + ',')
+        lines.append('};')
+        lines.append('')
+
+    lines.append('static const EmbeddedAsset embeddedAssets[] = {')
+    for i, filename in enumerate(input_filenames):
+        lines.append('    {{"{}", asset_{}, sizeof(asset_{})}},'.format(
+            os.path.basename(filename), i, i))
+    lines.append('};')
+    lines.append('')
+    lines.append('const EmbeddedAsset * findEmbeddedAsset(const std::string & filename)')
+    lines.append('{')
+    lines.append('    for (const auto & asset : embeddedAssets)')
+    lines.append('    {')
+    lines.append('        if (filename == asset.filename)')
+    lines.append('            return &asset;')
+    lines.append('    }')
+    lines.append('')
+    lines.append('    return nullptr;')
+    lines.append('}')
+
+    with open(output_filename, 'w') as f:
+        f.write('\n'.join(lines) + '\n')
+
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())